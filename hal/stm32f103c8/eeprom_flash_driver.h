@@ -2,10 +2,12 @@
 #define __EEPROM_FLASH_DRIVER__
 
 #include "main.h"
+#include "eeprom_emu.h"
 
 // 1K page for stm32f103 => 2K bank => 4K total
 #define EEPROM_EMU_BANK_SIZE   (FLASH_PAGE_SIZE*2) // Single page size 1K
-#define EEPROM_EMU_FLASH_START (FLASH_BANK1_END + 1 - EEPROM_EMU_BANK_SIZE*2)
+#define EEPROM_EMU_BANK_COUNT  2
+#define EEPROM_EMU_FLASH_START (FLASH_BANK1_END + 1 - EEPROM_EMU_BANK_SIZE*EEPROM_EMU_BANK_COUNT)
 /*
 #define XSTR(x) STR(x)
 #define STR(x) #x
@@ -15,19 +17,27 @@
 class EepromFlashDriver
 {
 public:
-    enum { BankSize = EEPROM_EMU_BANK_SIZE };
-
-    void erase(uint8_t bank)
+    enum {
+        BankSize = EEPROM_EMU_BANK_SIZE,
+        BankCount = EEPROM_EMU_BANK_COUNT,
+        ProgramWidth = 2,
+        EraseSize = FLASH_PAGE_SIZE,
+        // Single unlock for all writes of flush & bank move
+        LockScope = EEPROM_LOCK_PER_FLUSH
+    };
+
+    void unlock() { HAL_FLASH_Unlock(); }
+    void lock() { HAL_FLASH_Lock(); }
+
+    void erase(uint8_t bank, uint32_t addr)
     {
         FLASH_EraseInitTypeDef s_eraseinit;
         s_eraseinit.TypeErase   = FLASH_TYPEERASE_PAGES;
-        s_eraseinit.PageAddress = EEPROM_EMU_FLASH_START + bank*EEPROM_EMU_BANK_SIZE;
-        s_eraseinit.NbPages     = EEPROM_EMU_BANK_SIZE / FLASH_PAGE_SIZE;
+        s_eraseinit.PageAddress = EEPROM_EMU_FLASH_START + bank*EEPROM_EMU_BANK_SIZE + addr;
+        s_eraseinit.NbPages     = 1;
         uint32_t page_error = 0;
 
-        HAL_FLASH_Unlock();
         HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
-        HAL_FLASH_Lock();
     }
 
     uint16_t read_u16(uint8_t bank, uint32_t addr)
@@ -46,9 +56,7 @@ public:
     {
         uint32_t flash_addr = EEPROM_EMU_FLASH_START + bank*EEPROM_EMU_BANK_SIZE + addr;
 
-        HAL_FLASH_Unlock();
         HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, flash_addr, data);
-        HAL_FLASH_Lock();
     }
 };
 
@@ -2,32 +2,43 @@
 #include "app.h"
 #include "app_hal.h"
 
+#include "config_map.h"
 #include "eeprom_emu.h"
 #include "eeprom_flash_driver.h"
 
 #include "meter.h"
 #include "io.h"
+#include "scheduler.h"
 
 #include "calibrator/calibrator.h"
-#include "calibrator/calibrator_noise.h"
 
 
 // Note: update version tag to reset old data
-EepromEmu<EepromFlashDriver, 0x0003> eeprom;
+EepromEmu<EepromFlashDriver, 0x0003, CFG_ADDR_SPACE, true> eeprom;
+
+config_t config;
 
 Io io;
 Meter meter;
 Regulator regulator;
 Calibrator calibrator;
-CalibratorNoise calibrator_noise;
+Scheduler<4> scheduler;
+
 
+void config_write(cfg_id_t id, fix16_t val) {
+    const cfg_entry_t &e = cfg_schema[id];
+    uint32_t raw = cfg_clamp(e, (uint32_t)val);
+
+    *(uint32_t *)((uint8_t *)&config + e.offset) = raw;
+    eeprom.write_u32(e.addr, raw);
+}
 
-float eeprom_float_read(uint32_t addr, float dflt) {
-    return eeprom.read_float(addr, dflt);
+void eeprom_group_begin() {
+    eeprom.begin();
 }
 
-void eeprom_float_write(uint32_t addr, float val) {
-    return eeprom.write_float(addr, val);
+void eeprom_group_commit() {
+    eeprom.commit();
 }
 
 
@@ -36,10 +47,18 @@ int main()
     hal::setup();
 
     // Load config info from emulated EEPROM
+    cfg_migrate(eeprom);
+    cfg_load(eeprom, config);
+
     io.configure();
     regulator.configure();
     meter.configure();
 
+    // Background tasks. EEPROM flush does single flash operation per call,
+    // so run it once per ADC tick.
+    scheduler.add([]() { return eeprom.tick(); }, 5, 1);
+    scheduler.add([]() { return meter.persist_tick(); }, 10, 1);
+
     hal::start();
 
     while (1) {
@@ -48,13 +67,14 @@ int main()
         io_data_t io_data;
         io.out.pop(io_data);
 
-        if (calibrator_noise.tick(io_data)) break;
+        if (calibrator.boot_tick(io_data)) break;
     }
 
     // Override loop in main.c to reduce patching
     while (1) {
-        // Polling for flag which indicates that ADC data is ready
-        while (io.out.empty()) {}
+        // Polling for flag which indicates that ADC data is ready.
+        // Run background tasks while waiting.
+        scheduler.wait([]() { return !io.out.empty(); });
 
         io_data_t io_data;
         io.out.pop(io_data);
@@ -67,13 +87,13 @@ int main()
 
         // Normal processing
 
-        if (meter.is_r_calibrated)
+        if (meter.is_r_calibrated && !config.adrc_pending)
         {
             regulator.tick(io_data.knob, meter.speed);
             io.setpoint = regulator.out_power;
         }
         else {
-            // Force speed to some slow value when R is not calibrated
+            // Force speed to some slow value until motor is calibrated
             io.setpoint = F16(0.2);
         }
     }
@@ -3,8 +3,16 @@
 
 #include <stdint.h>
 
-float eeprom_float_read(uint32_t addr, float dflt);
-void eeprom_float_write(uint32_t addr, float val);
+#include "config_map.h"
+
+// Config values, loaded from EEPROM on boot
+extern config_t config;
+
+// Update config value in RAM & EEPROM. Value is clamped to allowed range.
+void config_write(cfg_id_t id, fix16_t val);
+// Writes between begin & commit are stored atomically
+void eeprom_group_begin();
+void eeprom_group_commit();
 
 #include "io.h"
 
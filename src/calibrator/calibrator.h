@@ -3,11 +3,17 @@
 
 // Detect when user dials knob 3 times, start calibration sequence and
 // update configuration.
+//
+// Also runs boot-time calibrations (noise & motor profile match).
+
+#include <new>
 
 #include "math/fix16_math.h"
 #include "yield.h"
 
 #include "../app.h"
+#include "calibrator_noise.h"
+#include "calibrator_profile_match.h"
 #include "calibrator_wait_knob_dial.h"
 #include "calibrator_static.h"
 #include "calibrator_adrc.h"
@@ -17,6 +23,29 @@ class Calibrator
 {
 public:
 
+    // Boot-time calibrations. Returns `true` when finished.
+    bool boot_tick(io_data_t &io_data) {
+        YIELDABLE_WITH(boot_frame);
+
+        meter.r_adapt_enabled = false;
+
+        start_phase(phase.noise);
+        YIELD_UNTIL(phase.noise.tick(io_data), false);
+
+        // On first boot try to pick known motor profile, instead of
+        // slow run without calibration
+        if (!meter.is_r_calibrated)
+        {
+            start_phase(phase.profile_match);
+            YIELD_UNTIL(phase.profile_match.tick(io_data), false);
+        }
+
+        meter.r_adapt_enabled = true;
+
+        start_phase(phase.wait_knob_dial);
+        return true;
+    }
+
     // Returns:
     //
     // - false: we should continue in normal mode
@@ -24,20 +53,53 @@ public:
     //          loop until finished.
     //
     bool tick(io_data_t &io_data) {
-        YIELDABLE;
+        YIELDABLE_WITH(tick_frame);
+
+        YIELD_UNTIL(phase.wait_knob_dial.tick(io_data), false);
 
-        YIELD_UNTIL(wait_knob_dial.tick(io_data), false);
-        YIELD_UNTIL(calibrate_static.tick(io_data), true);
-        YIELD_UNTIL(calibrate_adrc.tick(io_data), true);
+        meter.r_adapt_enabled = false;
 
+        start_phase(phase.calibrate_static);
+        YIELD_UNTIL(phase.calibrate_static.tick(io_data), true);
+
+        start_phase(phase.calibrate_adrc);
+        YIELD_UNTIL(phase.calibrate_adrc.tick(io_data), true);
+
+        meter.r_adapt_enabled = true;
+
+        start_phase(phase.wait_knob_dial);
         return false;
     }
 
+    // Restart both FSMs from the beginning
+    void reset()
+    {
+        boot_frame.reset();
+        tick_frame.reset();
+        start_phase(phase.wait_knob_dial);
+    }
+
 private:
-    // Nested FSM-s
-    CalibratorWaitKnobDial wait_knob_dial;
-    CalibratorStatic calibrate_static;
-    CalibratorADRC calibrate_adrc;
+    yield_frame_t boot_frame;
+    yield_frame_t tick_frame;
+
+    // Nested FSM-s. Those never run at the same time, so share the same
+    // memory. Only active one is alive (constructed on phase start). Union
+    // takes the size of the biggest phase (ADRC calibrator, with speed data
+    // buffer). Check real numbers with `arm-none-eabi-size` on target build.
+    union Phases {
+        Phases() {}
+        ~Phases() {}
+
+        CalibratorNoise noise;
+        CalibratorProfileMatch profile_match;
+        CalibratorWaitKnobDial wait_knob_dial;
+        CalibratorStatic calibrate_static;
+        CalibratorADRC calibrate_adrc;
+    } phase;
+
+    template <typename T>
+    void start_phase(T &storage) { new (&storage) T(); }
 };
 
 #endif
@@ -2,6 +2,7 @@
 #define __CALIBRATOR_ADRC__
 
 #include "../math/fix16_math.h"
+#include "../yield.h"
 #include "../app.h"
 
 #include <limits.h>
@@ -76,7 +77,7 @@ class CalibratorADRC {
 public:
 
     bool tick(io_data_t &io_data) {
-        YIELDABLE;
+        YIELDABLE_WITH(tick_frame);
 
         //
         // Before start time measure motor must run at steady low speed
@@ -180,7 +181,7 @@ public:
         //
 
         // Reset scaling factor
-        meter.cfg_rekv_to_speed_factor = fix16_one;
+        meter.set_rekv_to_speed_factor(fix16_one);
         io.setpoint = F16(SPEED_FACTOR_SETPOINT);
 
         speed_tracker.reset();
@@ -199,13 +200,10 @@ public:
         }
 
         // Extrapolate measured value to setpoint=1.0
-        float speed_factor = fix16_to_float(fix16_div(speed_tracker.average(),
-          F16(SPEED_FACTOR_SETPOINT)));
-        
-        eeprom_float_write(
-          CFG_REKV_TO_SPEED_FACTOR_ADDR,
-          speed_factor
-        );
+        fix16_t speed_factor = fix16_div(speed_tracker.average(),
+          F16(SPEED_FACTOR_SETPOINT));
+
+        config_write(CFG_REKV_TO_SPEED_FACTOR, speed_factor);
 
         meter.configure();
 
@@ -213,15 +211,8 @@ public:
         // Calculate speed setting values for picking ADRC regulator parameters
         //
 
-        fix16_t cfg_rpm_max_limit = fix16_from_float(
-          eeprom_float_read(CFG_RPM_MAX_LIMIT_ADDR, CFG_RPM_MAX_LIMIT_DEFAULT)
-        );
-
-        fix16_t cfg_rpm_min_limit = fix16_from_float(
-          eeprom_float_read(CFG_RPM_MIN_LIMIT_ADDR, CFG_RPM_MIN_LIMIT_DEFAULT)
-        );
-
-        fix16_t rpm_min_rel = fix16_div(cfg_rpm_min_limit, cfg_rpm_max_limit);
+        // RPM values are < 65536 (checked by config schema), shift is safe
+        fix16_t rpm_min_rel = (fix16_t)((config.rpm_min_limit << 16) / config.rpm_max_limit);
 
         adrc_kp_speed_setting = rpm_min_rel;
         adrc_observers_speed_setting = rpm_min_rel;
@@ -544,29 +535,26 @@ public:
         // Store results
         //
 
-        eeprom_float_write(
-            CFG_ADRC_KP_ADDR,
-            fix16_to_float(adrc_kp_calibrated_value)
-        );
-        eeprom_float_write(
-            CFG_ADRC_KOBSERVERS_ADDR,
-            fix16_to_float(adrc_observers_calibrated_value)
-        );
-        eeprom_float_write(
-            CFG_ADRC_P_CORR_COEFF_ADDR,
-            fix16_to_float(adrc_p_corr_coeff_calibrated_value)
-        );
+        eeprom_group_begin();
+        config_write(CFG_ADRC_KP, adrc_kp_calibrated_value);
+        config_write(CFG_ADRC_KOBSERVERS, adrc_observers_calibrated_value);
+        config_write(CFG_ADRC_P_CORR_COEFF, adrc_p_corr_coeff_calibrated_value);
+        config_write(CFG_ADRC_PENDING, 0);
+        eeprom_group_commit();
 
         //
-        // Reload config & flush garbage after unsync, caused by long EEPROM write.
+        // Reload config. EEPROM is flushed in background, no unsync here.
         //
         regulator.configure();
-        meter.reset_state();
 
         return true;
     }
 
+    // Restart FSM from the beginning
+    void reset() { tick_frame.reset(); }
+
 private:
+    yield_frame_t tick_frame;
 
     // Desireable accuracy of ADRC calibration is 0.1
     // We need 7 iterations to achieve this accuracy
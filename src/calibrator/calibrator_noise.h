@@ -13,7 +13,7 @@ class CalibratorNoise
 public:
 
     bool tick(io_data_t &io_data) {
-        YIELDABLE;
+        YIELDABLE_WITH(tick_frame);
 
         io.setpoint = 0;
 
@@ -46,7 +46,12 @@ public:
         return true;
     }
 
+    // Restart FSM from the beginning
+    void reset() { tick_frame.reset(); }
+
 private:
+    yield_frame_t tick_frame;
+
     uint16_t acc_counter = 0;
     int64_t acc_p_sum_2e64 = 0;
     int64_t acc_i2_sum_2e64 = 0;
@@ -0,0 +1,173 @@
+#ifndef __CALIBRATOR_PROFILE_MATCH__
+#define __CALIBRATOR_PROFILE_MATCH__
+
+// Runs once at boot on uncalibrated unit. Quickly probes motor R at several
+// triac phases, and compares result with known motor profiles. If match
+// found - profile R table is written to EEPROM instead of static
+// calibration. Profiles have no measured ADRC data, so unit is marked as
+// ADRC pending and keeps slow open-loop run until user does full
+// calibration.
+//
+// Probe takes ~ 1 sec.
+
+#include "../math/fix16_math.h"
+#include "../yield.h"
+#include "../motor_profiles.h"
+
+#include "../app.h"
+
+// Max allowed R deviation from profile, to consider it matched.
+#define PROFILE_MATCH_TOLERANCE 0.1
+
+// Pulses per probe point, to average noise.
+#define PROFILE_PROBE_PULSES 3
+
+// Pause between pulses, to keep rotor stopped.
+constexpr int profile_probe_pause_ticks = APP_TICK_FREQUENCY / 10;
+
+// R table indexes to probe. Low and middle phases differ most between
+// motors, because of eddy losses.
+static const uint8_t profile_probe_points[] = { 0, 4 };
+
+constexpr int profile_probe_points_count = sizeof(profile_probe_points) / sizeof(profile_probe_points[0]);
+
+
+class CalibratorProfileMatch
+{
+public:
+
+    // Returns `true` when finished (with or without match).
+    bool tick(io_data_t &io_data) {
+        YIELDABLE_WITH(tick_frame);
+
+        io.setpoint = 0;
+
+        for (probe_idx = 0; probe_idx < profile_probe_points_count; probe_idx++)
+        {
+            r_sum = 0;
+
+            for (pulse_cnt = 0; pulse_cnt < PROFILE_PROBE_PULSES; pulse_cnt++)
+            {
+                acc_p_sum_2e32 = 0;
+                acc_i2_sum_2e32 = 0;
+
+                io.setpoint = 0;
+
+                ticks_cnt = 0;
+                YIELD_WHILE((ticks_cnt++ < profile_probe_pause_ticks), false);
+
+                YIELD_UNTIL(io_data.zero_cross_up, false);
+
+                //
+                // Record positive wave, the same way as static calibrator does
+                //
+
+                io.setpoint = meter.cfg_r_table_setpoints[profile_probe_points[probe_idx]];
+
+                // skip current zero point to force `while` wait next cross
+                YIELD(false);
+
+                while (!io_data.zero_cross_up)
+                {
+                    if (io_data.zero_cross_down) io.setpoint = 0;
+
+                    acc_p_sum_2e32 += (int64_t)io_data.voltage * io_data.current;
+                    acc_i2_sum_2e32 += (uint64_t)io_data.current * io_data.current;
+
+                    YIELD(false);
+                }
+
+                // Demagnetize core
+                YIELD_UNTIL(io_data.zero_cross_down, false);
+                io.setpoint = meter.cfg_r_table_setpoints[profile_probe_points[probe_idx]];
+                YIELD_UNTIL(io_data.zero_cross_up, false);
+                io.setpoint = 0;
+
+                {
+                    if (acc_p_sum_2e32 < 0) acc_p_sum_2e32 = 0;
+
+                    fix16_t r = fix16_ratio64(acc_p_sum_2e32, acc_i2_sum_2e32);
+
+                    // No current => motor not connected, nothing to match
+                    if (r == fix16_minimum) return true;
+
+                    r_sum += r;
+                }
+            }
+
+            r_probe[probe_idx] = r_sum / PROFILE_PROBE_PULSES;
+        }
+
+        int profile_idx = find_profile();
+
+        if (profile_idx >= 0) apply_profile(motor_profiles[profile_idx]);
+
+        return true;
+    }
+
+    // Restart FSM from the beginning
+    void reset() { tick_frame.reset(); }
+
+private:
+    yield_frame_t tick_frame;
+
+    int probe_idx = 0;
+    int pulse_cnt = 0;
+    int ticks_cnt = 0;
+
+    int64_t acc_p_sum_2e32 = 0;
+    uint64_t acc_i2_sum_2e32 = 0;
+
+    fix16_t r_sum = 0;
+    fix16_t r_probe[profile_probe_points_count];
+
+    // Returns index of best matched profile, or -1 if nothing found
+    int find_profile()
+    {
+        int best_idx = -1;
+        fix16_t best_deviation = F16(PROFILE_MATCH_TOLERANCE);
+
+        for (int i = 0; i < motor_profiles_count; i++)
+        {
+            fix16_t deviation = 0;
+
+            for (int j = 0; j < profile_probe_points_count; j++)
+            {
+                fix16_t r_ref = motor_profiles[i].r_table[profile_probe_points[j]];
+                fix16_t d = fix16_div(fix16_abs(r_probe[j] - r_ref), r_ref);
+
+                if (d > deviation) deviation = d;
+            }
+
+            if (deviation < best_deviation)
+            {
+                best_deviation = deviation;
+                best_idx = i;
+            }
+        }
+
+        return best_idx;
+    }
+
+    void apply_profile(const motor_profile_t &profile)
+    {
+        eeprom_group_begin();
+
+        for (uint32_t i = 0; i < CFG_R_INTERP_TABLE_LENGTH; i++)
+        {
+            config_write((cfg_id_t)(CFG_R_INTERP_TABLE_START + i), profile.r_table[i]);
+        }
+
+        config_write(CFG_R_THERMAL_FACTOR, cfg_default_fix16(CFG_R_THERMAL_FACTOR));
+        config_write(CFG_ADRC_PENDING, 1);
+
+        eeprom_group_commit();
+
+        // Reload config
+        regulator.configure();
+        meter.configure();
+    }
+};
+
+
+#endif
@@ -5,6 +5,7 @@
 // - Calculate motor's R.
 
 #include "../math/fix16_math.h"
+#include "../yield.h"
 #include "../math/stability_filter.h"
 
 #include "../app.h"
@@ -16,7 +17,7 @@ class CalibratorStatic
 public:
 
     bool tick(io_data_t &io_data) {
-        YIELDABLE;
+        YIELDABLE_WITH(tick_frame);
 
         //
         // Reset variables and wait 2 sec to make sure motor stopped.
@@ -98,11 +99,7 @@ public:
                 {
                     if (acc_p_sum_2e32 < 0) acc_p_sum_2e32 = 0;
 
-                    uint64_t p = acc_p_sum_2e32, i2 = acc_i2_sum_2e32;
-
-                    NORMALIZE_TO_31_BIT(p, i2)
-
-                    r_stability_filter.push(fix16_div((fix16_t)p, (fix16_t)i2));
+                    r_stability_filter.push(fix16_ratio64(acc_p_sum_2e32, acc_i2_sum_2e32));
                 }
             }
 
@@ -120,20 +117,29 @@ public:
         }
 
         // Write result to EEPROM
+        eeprom_group_begin();
+
         for (uint32_t i = 0; i < CFG_R_INTERP_TABLE_LENGTH; i++)
         {
-            eeprom_float_write(
-                CFG_R_INTERP_TABLE_START_ADDR + i,
-                fix16_to_float(r_interp_result[i])
-            );
+            config_write((cfg_id_t)(CFG_R_INTERP_TABLE_START + i), r_interp_result[i]);
         }
 
+        // New table is measured at current motor temperature,
+        // reset thermal drift.
+        config_write(CFG_R_THERMAL_FACTOR, cfg_default_fix16(CFG_R_THERMAL_FACTOR));
+
+        eeprom_group_commit();
+
         // Reload sensor's config.
         meter.configure();
         return true;
     }
 
+    // Restart FSM from the beginning
+    void reset() { tick_frame.reset(); }
+
 private:
+    yield_frame_t tick_frame;
 
     float i_avg = 0;
 
@@ -9,6 +9,10 @@
 
 
 #include "../math/fix16_math.h"
+#include "../yield.h"
+#ifdef YIELD_USE_COROUTINES
+#include "../yield_coro.h"
+#endif
 
 #include "../app.h"
 
@@ -22,12 +26,87 @@ constexpr int knob_wait_min = (int)(APP_TICK_FREQUENCY * 0.2f);
 constexpr int knob_wait_max = (int)(APP_TICK_FREQUENCY * 1.0f);
 
 
+#ifdef YIELD_USE_COROUTINES
+
 class CalibratorWaitKnobDial
 {
 public:
 
     bool tick(io_data_t &io_data) {
-        YIELDABLE;
+        io_data_ptr = &io_data;
+
+        if (!coro.active()) coro = run();
+        return coro.resume();
+    }
+
+    // Restart FSM from the beginning
+    void reset() { coro.reset(); }
+
+private:
+    friend struct yield_coro_t::promise_type;
+
+    yield_coro_frame_t<64> coro_frame;
+    yield_coro_t coro;
+
+    io_data_t *io_data_ptr = nullptr;
+
+    yield_coro_t run() {
+        // Try endless
+        while (1)
+        {
+            // First, check knob is at sstart position (zero),
+            // prior to start detect dial sequence
+            int ticks_cnt = 0;
+            co_yield false;
+
+            while (IS_KNOB_LOW(io_data_ptr->knob)) {
+                co_yield false;
+                ticks_cnt++;
+            }
+
+            if (ticks_cnt < knob_wait_min) continue;
+
+            // If knob is zero long enough => can start detect dials
+            int dials_cnt = 0;
+
+            while (1) {
+                // Measure UP interval
+                ticks_cnt = 0;
+
+                while (IS_KNOB_HIGH(io_data_ptr->knob)) {
+                    co_yield false;
+                    ticks_cnt++;
+                }
+
+                // Resart on invalid length
+                if (ticks_cnt < knob_wait_min || ticks_cnt > knob_wait_max) break;
+
+                // Finish on success
+                if (++dials_cnt >= 3) co_return true;
+
+                // Measure DOWN interval
+                ticks_cnt = 0;
+
+                while (IS_KNOB_LOW(io_data_ptr->knob)) {
+                    co_yield false;
+                    ticks_cnt++;
+                }
+
+                // Restart on invalid length
+                if (ticks_cnt < knob_wait_min || ticks_cnt > knob_wait_max) break;
+            }
+        }
+    }
+};
+
+#else
+
+class CalibratorWaitKnobDial
+{
+public:
+
+    bool tick(io_data_t &io_data) {
+        YIELDABLE_WITH(tick_frame);
 
         // Try endless
         while (1)
@@ -77,12 +156,18 @@ public:
         }
     }
 
+    // Restart FSM from the beginning
+    void reset() { tick_frame.reset(); }
+
 private:
+    yield_frame_t tick_frame;
 
     int ticks_cnt = 0;
     int dials_cnt = 0;
 
 };
 
+#endif
+
 
 #endif
@@ -2,49 +2,330 @@
 #define __CONFIG_MAP__
 
 //
-// Virtual EEPROM addresses & defaults for config variables.
+// Virtual EEPROM addresses, defaults & allowed ranges for config variables.
 // Emulator uses append-only log & multiphase commits to guarantee
 // atomic writes.
 //
+// Values are stored in the same format as used in code (fix16 or integer),
+// so config load needs no float math. All values are loaded at once into
+// `config_t`. Stored values out of range are replaced with defaults.
+//
+// Note: update EEPROM version tag in `app.cpp`, if storage format changed
+// and old data can't be converted (see `cfg_migrate()`).
+//
 
-// Current sensor shunt resistance (mOhm)
-#define CFG_SHUNT_RESISTANCE_ADDR 1
-#define CFG_SHUNT_RESISTANCE_DEFAULT 10.0f
+#include <stdint.h>
+#include <stddef.h>
 
-// RPM at max voltage without load
-#define CFG_RPM_MAX_ADDR 2
-#define CFG_RPM_MAX_DEFAULT 37500.0f
+#include "math/fix16_math.h"
+#include "math/knob_curve.h"
 
-// Minimal allowed speed (RPM)
-#define CFG_RPM_MIN_LIMIT_ADDR 3
-#define CFG_RPM_MIN_LIMIT_DEFAULT 5000.0f
 
-// Maximal allowed speed (RPM)
-#define CFG_RPM_MAX_LIMIT_ADDR 4
-#define CFG_RPM_MAX_LIMIT_DEFAULT 30000.0f
+#define CFG_R_INTERP_TABLE_LENGTH 7
 
-// Knob initial zone where motor should not run (% of max range).
-#define CFG_DEAD_ZONE_WIDTH_ADDR 5
-#define CFG_DEAD_ZONE_WIDTH_DEFAULT 2.0f
+// Max address + 1 (with some reserve). Used to size EEPROM emulator's RAM index.
+#define CFG_ADDR_SPACE 32
 
-// ADRC parameters (auto-calibrated).
-#define CFG_ADRC_KP_ADDR 6
-#define CFG_ADRC_KP_DEFAULT 1.0f
+// Storage format of config values. Absent on units with old firmware, which
+// stored all values as float. During migration keeps number of converted
+// schema entries (with CFG_FORMAT_MIGRATING flag).
+#define CFG_FORMAT_ADDR (CFG_ADDR_SPACE - 1)
+#define CFG_FORMAT_FLOAT 0
+#define CFG_FORMAT_NATIVE 1
+#define CFG_FORMAT_MIGRATING 0x8000
 
-#define CFG_ADRC_KOBSERVERS_ADDR 7
-#define CFG_ADRC_KOBSERVERS_DEFAULT 1.0f
+// Schema entries converted per EEPROM group (+ format record). Group should
+// fit emulator queue, to be atomic.
+#define CFG_MIGRATE_GROUP_SIZE 8
 
-#define CFG_ADRC_P_CORR_COEFF_ADDR 8
-#define CFG_ADRC_P_CORR_COEFF_DEFAULT 0.0f
 
-// Constructive coefficient between normalized motor speed.
-// and back-EMF equivalent resistance (auto-calibrated).
-#define CFG_REKV_TO_SPEED_FACTOR_ADDR 9
-#define CFG_REKV_TO_SPEED_FACTOR_DEFAULT 450.0f
+struct config_t {
+    // Current sensor shunt resistance (mOhm)
+    fix16_t shunt_resistance;
 
-// Active resistance interpolaion table (depends on triac phase).
-#define CFG_R_INTERP_TABLE_START_ADDR 10
-#define CFG_R_INTERP_TABLE_LENGTH 7
+    // RPM at max voltage without load
+    uint32_t rpm_max;
+
+    // Minimal allowed speed (RPM)
+    uint32_t rpm_min_limit;
+
+    // Maximal allowed speed (RPM)
+    uint32_t rpm_max_limit;
+
+    // Knob initial zone where motor should not run (% of max range).
+    fix16_t dead_zone_width;
+
+    // ADRC parameters (auto-calibrated).
+    fix16_t adrc_kp;
+    fix16_t adrc_kobservers;
+    fix16_t adrc_p_corr_coeff;
+
+    // Constructive coefficient between normalized motor speed.
+    // and back-EMF equivalent resistance (auto-calibrated).
+    fix16_t rekv_to_speed_factor;
+
+    // Active resistance interpolaion table (depends on triac phase).
+    // 0 if not calibrated.
+    fix16_t r_interp_table[CFG_R_INTERP_TABLE_LENGTH];
+
+    // Motor resistance thermal drift, relative to R interpolation table
+    // (auto-updated on each motor start).
+    fix16_t r_thermal_factor;
+
+    // Knob => speed curve, `knob_curve_type_t`
+    uint32_t knob_curve;
+
+    // Knob hysteresis (% of max range), 0 - disabled. Limited to half of
+    // dead zone.
+    fix16_t knob_hysteresis;
+
+    // Speed (% of [min..max] limits range) for evenly spaced knob positions,
+    // used with KNOB_CURVE_USER_POINTS.
+    fix16_t knob_curve_points[KNOB_CURVE_POINTS_COUNT];
+
+    // 1 - R table is taken from motor profile, ADRC is not calibrated yet.
+    // Regulator stays off until full calibration.
+    uint32_t adrc_pending;
+};
+
+
+enum cfg_id_t {
+    CFG_SHUNT_RESISTANCE,
+    CFG_RPM_MAX,
+    CFG_RPM_MIN_LIMIT,
+    CFG_RPM_MAX_LIMIT,
+    CFG_DEAD_ZONE_WIDTH,
+    CFG_ADRC_KP,
+    CFG_ADRC_KOBSERVERS,
+    CFG_ADRC_P_CORR_COEFF,
+    CFG_REKV_TO_SPEED_FACTOR,
+    CFG_R_INTERP_TABLE_START,
+    CFG_R_THERMAL_FACTOR = CFG_R_INTERP_TABLE_START + CFG_R_INTERP_TABLE_LENGTH,
+    CFG_KNOB_CURVE,
+    CFG_KNOB_HYSTERESIS,
+    CFG_KNOB_CURVE_POINTS_START,
+    CFG_ADRC_PENDING = CFG_KNOB_CURVE_POINTS_START + KNOB_CURVE_POINTS_COUNT,
+    CFG_COUNT
+};
+
+
+enum cfg_type_t : uint8_t {
+    CFG_TYPE_FIX16,
+    CFG_TYPE_U32
+};
+
+struct cfg_entry_t {
+    uint16_t addr;
+    // Offset of value in `config_t`
+    uint16_t offset;
+    cfg_type_t type;
+    // Default & range, in storage format
+    uint32_t dflt;
+    uint32_t min;
+    uint32_t max;
+};
+
+constexpr cfg_entry_t cfg_fix16(uint16_t addr, size_t offset, double dflt, double min, double max)
+{
+    return { addr, (uint16_t)offset, CFG_TYPE_FIX16,
+        (uint32_t)F16(dflt), (uint32_t)F16(min), (uint32_t)F16(max) };
+}
+
+constexpr cfg_entry_t cfg_u32(uint16_t addr, size_t offset, uint32_t dflt, uint32_t min, uint32_t max)
+{
+    return { addr, (uint16_t)offset, CFG_TYPE_U32, dflt, min, max };
+}
+
+#define _CFG_OFS(field) offsetof(config_t, field)
+
+// Order must follow `cfg_id_t`
+constexpr cfg_entry_t cfg_schema[CFG_COUNT] = {
+    cfg_fix16(1,  _CFG_OFS(shunt_resistance),     10.0,    1.0,   100.0),
+    cfg_u32  (2,  _CFG_OFS(rpm_max),              37500,   1000,  60000),
+    cfg_u32  (3,  _CFG_OFS(rpm_min_limit),        5000,    0,     60000),
+    cfg_u32  (4,  _CFG_OFS(rpm_max_limit),        30000,   1000,  60000),
+    cfg_fix16(5,  _CFG_OFS(dead_zone_width),      2.0,     0.0,   50.0),
+    cfg_fix16(6,  _CFG_OFS(adrc_kp),              1.0,     0.0,   1000.0),
+    cfg_fix16(7,  _CFG_OFS(adrc_kobservers),      1.0,     0.0,   1000.0),
+    cfg_fix16(8,  _CFG_OFS(adrc_p_corr_coeff),    0.0,     0.0,   1000.0),
+    cfg_fix16(9,  _CFG_OFS(rekv_to_speed_factor), 450.0,   1.0,   30000.0),
+    cfg_fix16(10, _CFG_OFS(r_interp_table[0]),    0.0,     0.0,   30000.0),
+    cfg_fix16(11, _CFG_OFS(r_interp_table[1]),    0.0,     0.0,   30000.0),
+    cfg_fix16(12, _CFG_OFS(r_interp_table[2]),    0.0,     0.0,   30000.0),
+    cfg_fix16(13, _CFG_OFS(r_interp_table[3]),    0.0,     0.0,   30000.0),
+    cfg_fix16(14, _CFG_OFS(r_interp_table[4]),    0.0,     0.0,   30000.0),
+    cfg_fix16(15, _CFG_OFS(r_interp_table[5]),    0.0,     0.0,   30000.0),
+    cfg_fix16(16, _CFG_OFS(r_interp_table[6]),    0.0,     0.0,   30000.0),
+    cfg_fix16(17, _CFG_OFS(r_thermal_factor),     1.0,     0.5,   2.0),
+    cfg_u32  (18, _CFG_OFS(knob_curve),           KNOB_CURVE_LINEAR, KNOB_CURVE_LINEAR, KNOB_CURVE_USER_POINTS),
+    cfg_fix16(19, _CFG_OFS(knob_hysteresis),      0.0,     0.0,   5.0),
+    cfg_fix16(20, _CFG_OFS(knob_curve_points[0]), 0.0,     0.0,   100.0),
+    cfg_fix16(21, _CFG_OFS(knob_curve_points[1]), 25.0,    0.0,   100.0),
+    cfg_fix16(22, _CFG_OFS(knob_curve_points[2]), 50.0,    0.0,   100.0),
+    cfg_fix16(23, _CFG_OFS(knob_curve_points[3]), 75.0,    0.0,   100.0),
+    cfg_fix16(24, _CFG_OFS(knob_curve_points[4]), 100.0,   0.0,   100.0),
+    cfg_u32  (25, _CFG_OFS(adrc_pending),         0,       0,     1)
+};
+
+#undef _CFG_OFS
+
+
+//
+// Compile-time schema checks
+//
+
+constexpr bool cfg_addresses_unique()
+{
+    for (int i = 0; i < CFG_COUNT; i++)
+    {
+        for (int j = i + 1; j < CFG_COUNT; j++)
+        {
+            if (cfg_schema[i].addr == cfg_schema[j].addr) return false;
+        }
+    }
+    return true;
+}
+
+// Every `config_t` field is covered, once
+constexpr bool cfg_offsets_unique()
+{
+    for (int i = 0; i < CFG_COUNT; i++)
+    {
+        if (cfg_schema[i].offset % 4) return false;
+
+        for (int j = i + 1; j < CFG_COUNT; j++)
+        {
+            if (cfg_schema[i].offset == cfg_schema[j].offset) return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool cfg_defaults_in_range()
+{
+    for (int i = 0; i < CFG_COUNT; i++)
+    {
+        const cfg_entry_t &e = cfg_schema[i];
+
+        if (e.type == CFG_TYPE_FIX16)
+        {
+            if ((int32_t)e.dflt < (int32_t)e.min || (int32_t)e.dflt > (int32_t)e.max) return false;
+        }
+        else if (e.dflt < e.min || e.dflt > e.max) return false;
+    }
+    return true;
+}
+
+constexpr bool cfg_addresses_fit()
+{
+    for (int i = 0; i < CFG_COUNT; i++)
+    {
+        if (cfg_schema[i].addr >= CFG_FORMAT_ADDR) return false;
+    }
+    return true;
+}
+
+static_assert(sizeof(config_t) == CFG_COUNT * 4, "config_t fields should match schema");
+static_assert(cfg_addresses_unique(), "Config addresses collision");
+static_assert(cfg_offsets_unique(), "Config fields collision");
+static_assert(cfg_defaults_in_range(), "Config default out of range");
+static_assert(cfg_addresses_fit(), "Config address out of CFG_ADDR_SPACE (or used by format record)");
+
+
+inline bool cfg_is_valid(const cfg_entry_t &e, uint32_t val)
+{
+    if (e.type == CFG_TYPE_FIX16)
+    {
+        return (int32_t)val >= (int32_t)e.min && (int32_t)val <= (int32_t)e.max;
+    }
+    return val >= e.min && val <= e.max;
+}
+
+inline uint32_t cfg_clamp(const cfg_entry_t &e, uint32_t val)
+{
+    if (cfg_is_valid(e, val)) return val;
+
+    if (e.type == CFG_TYPE_FIX16) return ((int32_t)val < (int32_t)e.min) ? e.min : e.max;
+    return (val < e.min) ? e.min : e.max;
+}
+
+// Load all values in one pass
+template <typename EEPROM>
+void cfg_load(EEPROM &eeprom, config_t &cfg)
+{
+    for (int i = 0; i < CFG_COUNT; i++)
+    {
+        const cfg_entry_t &e = cfg_schema[i];
+        uint32_t val = eeprom.read_u32(e.addr, e.dflt);
+
+        if (!cfg_is_valid(e, val)) val = e.dflt;
+
+        *(uint32_t *)((uint8_t *)&cfg + e.offset) = val;
+    }
+}
+
+// Old float value => storage format. Invalid ones (incl. old "not
+// calibrated" R marker 123456789) => default.
+inline uint32_t cfg_from_float(const cfg_entry_t &e, uint32_t raw)
+{
+    union { uint32_t i; float f; } x;
+    x.i = raw;
+
+    uint32_t val = e.dflt;
+
+    if (e.type == CFG_TYPE_FIX16)
+    {
+        if (x.f > -32767.0f && x.f < 32767.0f) val = (uint32_t)fix16_from_float(x.f);
+    }
+    else if (x.f >= 0.0f && x.f < 4294967040.0f) val = (uint32_t)(x.f + 0.5f);
+
+    return cfg_is_valid(e, val) ? val : e.dflt;
+}
+
+// Convert values of old firmware (stored as float) in place, to keep
+// calibration on upgrade. Runs once, before `cfg_load()`. Every group has
+// progress record, so migration continues correctly after power loss.
+template <typename EEPROM>
+void cfg_migrate(EEPROM &eeprom)
+{
+    uint32_t format = eeprom.read_u32(CFG_FORMAT_ADDR, CFG_FORMAT_FLOAT);
+
+    if (format == CFG_FORMAT_NATIVE) return;
+
+    int done = (format & CFG_FORMAT_MIGRATING) ? (int)(format & ~CFG_FORMAT_MIGRATING) : 0;
+
+    while (done < CFG_COUNT)
+    {
+        int end = done + CFG_MIGRATE_GROUP_SIZE;
+        if (end > CFG_COUNT) end = CFG_COUNT;
+
+        eeprom.begin();
+
+        for (int i = done; i < end; i++)
+        {
+            const cfg_entry_t &e = cfg_schema[i];
+
+            // 0xFFFFFFFF is NaN, never written by old firmware => no record
+            uint32_t raw = eeprom.read_u32(e.addr, 0xFFFFFFFF);
+
+            if (raw != 0xFFFFFFFF) eeprom.write_u32(e.addr, cfg_from_float(e, raw));
+        }
+
+        eeprom.write_u32(CFG_FORMAT_ADDR,
+            end < CFG_COUNT ? (uint32_t)(CFG_FORMAT_MIGRATING | end) : CFG_FORMAT_NATIVE);
+
+        eeprom.commit();
+        // Next group should not be merged with this one in queue
+        eeprom.flush();
+
+        done = end;
+    }
+}
+
+constexpr fix16_t cfg_default_fix16(cfg_id_t id)
+{
+    return (fix16_t)cfg_schema[id].dflt;
+}
 
 
 #endif
@@ -4,17 +4,45 @@
 
 #include <stdint.h>
 
+#include "yield.h"
+
+// Who locks flash after programming
+enum {
+    // Driver unlocks & locks on every write/erase
+    EEPROM_LOCK_PER_OP,
+    // Emulator unlocks once per record (4 half-words)
+    EEPROM_LOCK_PER_RECORD,
+    // Emulator unlocks once per flush (all pending records, bank move)
+    EEPROM_LOCK_PER_FLUSH
+};
+
 /* Driver
 class FlashDriver {
 public:
-    enum { BankSize = XXXX };
-    static void erase(uint8_t bank) {};
+    enum {
+        BankSize = XXXX,
+        BankCount = N,
+        // Program granularity, bytes: 2 (half-word) or 8 (double-word, ECC
+        // flashes, every double-word can be programmed once)
+        ProgramWidth = 2,
+        // Minimal erasable size, bytes. BankSize should be multiple of it.
+        EraseSize = XXXX,
+        LockScope = EEPROM_LOCK_PER_OP
+    };
+
+    // Erase single EraseSize page at bank offset `addr`
+    void erase(uint8_t bank, uint32_t addr);
 
-    static uint32_t read(uint8_t bank, uint16_t addr);
+    uint16_t read_u16(uint8_t bank, uint32_t addr);
 
-    // If 32bit write requires multiple operations, those MUST follow from
-    // least significant bits to most significant bits.
-    static uint32_t write(uint8_t bank, uint16_t addr, uint32_t data);
+    // ProgramWidth == 2
+    void write_u16(uint8_t bank, uint32_t addr, uint16_t data);
+    // ProgramWidth == 8
+    void write_u64(uint8_t bank, uint32_t addr, uint64_t data);
+
+    // Called by emulator, if LockScope != EEPROM_LOCK_PER_OP
+    void unlock();
+    void lock();
 }
 */
 
@@ -25,9 +53,14 @@ public:
 
     Bank Marker:
 
-    - [ 0x77EE, 0xFFFF,    VERSION, 0xFFFF ] => active, current
-    - [ 0x77EE, NOT_EMPTY, VERSION, 0xFFFF ] => ready to erase (!active)
-    - [ 0xFFFF, 0xFFFF,    0xFFFF,  0xFFFF ] => erased OR on progress of transfer
+    - [ 0x77EE, 0xFFFF,    VERSION, 0xFFFF ]    => active, current
+    - [ 0x77EE, 0xFFFF,    VERSION, NOT_EMPTY ] => active, superseded
+    - [ 0x77EE, NOT_EMPTY, VERSION, any ]       => ready to erase (!active)
+    - [ 0xFFFF, 0xFFFF,    0xFFFF,  0xFFFF ]    => erased OR on progress of transfer
+
+    Superseded mark is set on old bank before new one is activated. If power
+    lost before old bank cleaned, both banks are active, and the one without
+    superseded mark is newer.
 
     Data record:
 
@@ -38,24 +71,168 @@ public:
     allow old data partial override with zero bits.
 
     Value 0x55AA at record start means write was completed with success
+
+    Flash with 64-bit program (ProgramWidth = 8) can't write commit mark
+    separately. Whole record is written at once, and commit mark is
+    replaced with checksum, to detect torn writes:
+
+    [ 0x55AA ^ address_16 ^ data_lo_16 ^ data_hi_16, address_16, data_lo_16, data_hi_16 ]
+
+    Bank header takes 16 bytes, superseded mark is written to second half.
+    There is no room for dirty mark, superseded bank is erased when newer
+    active one exists.
+
+    Banks are used in rotation (0, 1, ... BankCount-1, 0...) to spread
+    erases. When bank is full, fresh records and pending writes are copied
+    to the next one, and only then it's marked active.
+
+    Group of records, written between begin() and commit():
+
+    [ 0xFFFF, address_16, data_lo_16, data_hi_16 ] x count
+    [ 0x33CC, count, ~count, 0xFFFF ]
+
+    Group members have no own commit marks. All become valid at once, when
+    group commit mark (0x33CC) is written. Members of unfinished group are
+    ignored. Several committed groups may be flushed as one.
+
+    Writes go to RAM queue (QUEUE_MAX records) first, reads check it before
+    flash. Queue is flushed by tick() FSM, one flash operation per call
+    (half-word program, page erase). Bank move is done the same way, step by
+    step. When queue is full, committed records are flushed to make room,
+    open group stays in queue. Only group larger than QUEUE_MAX alone is
+    split, and loses atomicity - keep groups smaller.
+
+    ASYNC - if false, write_u32() & commit() flush queue immediately.
+    If true, tick() should be called from main loop (background task).
+    Queue overflow falls back to immediate flush.
+
+    ADDR_SPACE - optional RAM index size (max virtual address + 1). If set,
+    index keeps offsets of fresh records for addresses below this value,
+    so reads & duplicates checks don't need to scan flash. Index is built
+    on init. Costs 2 bytes of RAM per address.
 */
 
-template <typename FLASH_DRIVER, uint16_t VERSION = 0xCC33>
+template <typename FLASH_DRIVER, uint16_t VERSION = 0xCC33, uint16_t ADDR_SPACE = 0, bool ASYNC = false>
 class EepromEmu
 {
     enum {
         EMPTY = 0xFFFF,
+        WIDE = (FLASH_DRIVER::ProgramWidth == 8),
         RECORD_SIZE = 8,
-        BANK_HEADER_SIZE = 8,
+        BANK_HEADER_SIZE = WIDE ? 16 : 8,
         COMMIT_MARK = 0x55AA,
         BANK_MARK = 0x77EE,
-        BANK_DIRTY_MARK = 0x5555
+        BANK_DIRTY_MARK = 0x5555,
+        BANK_SUPERSEDED_MARK = 0x5A5A,
+        GROUP_COMMIT_MARK = 0x33CC,
+        QUEUE_MAX = 16
     };
 
+    static_assert(FLASH_DRIVER::ProgramWidth == 2 || FLASH_DRIVER::ProgramWidth == 8,
+        "Unsupported flash program width");
+    static_assert(FLASH_DRIVER::BankSize % FLASH_DRIVER::EraseSize == 0,
+        "Bank should consist of whole erase pages");
+
     bool initialized = false;
     uint8_t current_bank = 0;
     uint32_t next_write_offset;
 
+    // Write queue:
+    //
+    // - [0, flush_count) - records being written to flash now
+    // - [.., committed_count) - committed, wait for flush
+    // - [.., queue_count) - open group
+    bool group_open = false;
+    uint8_t queue_count = 0;
+    uint8_t committed_count = 0;
+    uint8_t flush_count = 0;
+    uint16_t queue_addr[QUEUE_MAX];
+    uint32_t queue_val[QUEUE_MAX];
+
+    // Flush FSM state
+    yield_frame_t flush_frame;
+    // Flash is unlocked by emulator (LockScope != EEPROM_LOCK_PER_OP)
+    bool unlocked = false;
+    uint8_t flush_bank;
+    uint32_t flush_start;
+    uint32_t flush_i;
+    uint32_t flush_ofs;
+    uint32_t flush_size;
+    uint16_t flush_lo;
+    uint16_t flush_hi;
+
+    // Bank move state
+    yield_frame_t move_frame;
+    uint8_t move_from;
+    uint8_t move_to;
+    uint32_t move_src_ofs;
+    uint32_t move_dst_ofs;
+    uint32_t move_group_left;
+    uint16_t move_addr;
+    uint16_t move_lo;
+    uint16_t move_hi;
+    // Erase goes page by page from the end, header is destroyed last
+    uint32_t erase_ofs;
+    uint8_t move_copied[ADDR_SPACE > 0 ? (ADDR_SPACE + 7) / 8 : 1];
+
+    // Offsets of fresh records in current bank, 0 if not exists
+    uint16_t index[ADDR_SPACE > 0 ? ADDR_SPACE : 1];
+
+    void index_build()
+    {
+        if (ADDR_SPACE == 0) return;
+
+        for (uint32_t i = 0; i < ADDR_SPACE; i++) index[i] = 0;
+
+        uint32_t ofs = next_write_offset, group_left = 0;
+
+        // Backward scan, first met record is the most fresh
+        while (prev_valid(current_bank, ofs, group_left))
+        {
+            uint16_t addr = flash.read_u16(current_bank, ofs + 2);
+
+            if (addr < ADDR_SPACE && !index[addr]) index[addr] = (uint16_t)ofs;
+        }
+    }
+
+    // Step back from `ofs` to previous valid data record. Returns false
+    // when `bottom` reached. `group_left` tracks members of committed group
+    // to accept, should be 0 on start.
+    bool prev_valid(uint8_t bank, uint32_t &ofs, uint32_t &group_left,
+        uint32_t bottom = BANK_HEADER_SIZE)
+    {
+        while (ofs > bottom)
+        {
+            ofs -= RECORD_SIZE;
+
+            uint16_t mark = flash.read_u16(bank, ofs + 0);
+
+            if (group_left)
+            {
+                group_left--;
+                if (mark == EMPTY) return true;
+                continue;
+            }
+
+            if (WIDE)
+            {
+                if (mark == data_mark(flash.read_u16(bank, ofs + 2),
+                    flash.read_u16(bank, ofs + 4),
+                    flash.read_u16(bank, ofs + 6))) return true;
+            }
+            else if (mark == COMMIT_MARK) return true;
+
+            if (mark == GROUP_COMMIT_MARK)
+            {
+                uint16_t count = flash.read_u16(bank, ofs + 2);
+
+                if (flash.read_u16(bank, ofs + 4) == (uint16_t)~count) group_left = count;
+            }
+        }
+
+        return false;
+    }
+
     bool is_clear(uint8_t bank)
     {
         for (uint32_t i = 0; i < FLASH_DRIVER::BankSize; i += 2) {
@@ -64,156 +241,586 @@ class EepromEmu
         return true;
     }
 
+    // Synchronous, for init() only
+    void erase_bank(uint8_t bank)
+    {
+        for (uint32_t ofs = FLASH_DRIVER::BankSize; ofs > 0;)
+        {
+            ofs -= FLASH_DRIVER::EraseSize;
+            flash.erase(bank, ofs);
+        }
+    }
+
     bool is_active(uint8_t bank)
     {
-        if ((flash.read_u16(bank, 0) == BANK_MARK) &&
+        return (flash.read_u16(bank, 0) == BANK_MARK) &&
             (flash.read_u16(bank, 2) == EMPTY) &&
-            (flash.read_u16(bank, 4) == VERSION) &&
-            (flash.read_u16(bank, 6) == EMPTY)) return true;
+            (flash.read_u16(bank, 4) == VERSION);
+    }
 
-        return false;
+    bool is_superseded(uint8_t bank)
+    {
+        return flash.read_u16(bank, WIDE ? 8 : 6) != EMPTY;
+    }
+
+    // Commit mark of data record. Wide flash needs checksum (never EMPTY,
+    // and never matches group commit record).
+    uint16_t data_mark(uint16_t addr, uint16_t lo, uint16_t hi)
+    {
+        if (!WIDE) return COMMIT_MARK;
+
+        uint16_t mark = COMMIT_MARK ^ addr ^ lo ^ hi;
+        return (mark == EMPTY) ? (uint16_t)COMMIT_MARK : mark;
+    }
+
+    template <bool> struct wide_tag {};
+
+    void write_u64(uint8_t bank, uint32_t ofs, uint16_t w0, uint16_t w1,
+        uint16_t w2, uint16_t w3, wide_tag<true>)
+    {
+        flash.write_u64(bank, ofs, (uint64_t)w0 | ((uint64_t)w1 << 16) |
+            ((uint64_t)w2 << 32) | ((uint64_t)w3 << 48));
+    }
+
+    // Stub for half-word flashes, never called
+    void write_u64(uint8_t, uint32_t, uint16_t, uint16_t, uint16_t, uint16_t,
+        wide_tag<false>) {}
+
+    // Write 4 half-words at once (wide flash only)
+    void write_wide(uint8_t bank, uint32_t ofs, uint16_t w0, uint16_t w1,
+        uint16_t w2, uint16_t w3)
+    {
+        write_u64(bank, ofs, w0, w1, w2, w3, wide_tag<WIDE>());
     }
 
+    void lock_begin(uint8_t scope)
+    {
+        if (FLASH_DRIVER::LockScope == scope)
+        {
+            flash.unlock();
+            unlocked = true;
+        }
+    }
+
+    void lock_end(uint8_t scope)
+    {
+        if (FLASH_DRIVER::LockScope == scope)
+        {
+            flash.lock();
+            unlocked = false;
+        }
+    }
+
+    // Single flash operation for wide flash, 2 for half-word. Call with
+    // `step` = 0, 1, until returns `true`.
+    bool write_header_step(uint8_t bank, uint8_t step)
+    {
+        if (WIDE)
+        {
+            write_wide(bank, 0, BANK_MARK, EMPTY, VERSION, EMPTY);
+            return true;
+        }
+
+        if (step == 0) flash.write_u16(bank, 0, BANK_MARK);
+        else flash.write_u16(bank, 4, VERSION);
+
+        return step == 1;
+    }
+
+    // Single flash operation. Should not be called twice for the same bank
+    // (flash can't re-program).
+    void write_superseded(uint8_t bank)
+    {
+        if (WIDE)
+        {
+            write_wide(bank, 8, BANK_SUPERSEDED_MARK, BANK_SUPERSEDED_MARK,
+                BANK_SUPERSEDED_MARK, BANK_SUPERSEDED_MARK);
+        }
+        else flash.write_u16(bank, 6, BANK_SUPERSEDED_MARK);
+    }
+
+    // Half-word flash only, single operation
+    void write_dirty(uint8_t bank)
+    {
+        flash.write_u16(bank, 2, BANK_DIRTY_MARK);
+    }
+
+    bool is_empty_record(uint32_t ofs)
+    {
+        return (flash.read_u16(current_bank, ofs + 0) == EMPTY) &&
+            (flash.read_u16(current_bank, ofs + 2) == EMPTY) &&
+            (flash.read_u16(current_bank, ofs + 4) == EMPTY) &&
+            (flash.read_u16(current_bank, ofs + 6) == EMPTY);
+    }
+
+    // Records are appended one by one, so all slots before free space are
+    // used (even torn ones have some bits written), and all after are
+    // empty. That allows binary search of the boundary.
     uint32_t find_write_offset()
     {
-        uint32_t ofs = BANK_HEADER_SIZE;
+        const uint32_t slots = (FLASH_DRIVER::BankSize - BANK_HEADER_SIZE) / RECORD_SIZE;
 
-        for (; ofs <= FLASH_DRIVER::BankSize - RECORD_SIZE; ofs += RECORD_SIZE)
+        uint32_t lo = 0;
+        uint32_t hi = slots;
+
+        // Invariant: slots < lo are used, slots >= hi are empty
+        while (lo < hi)
         {
-            if ((flash.read_u16(current_bank, ofs + 0) == EMPTY) &&
-                (flash.read_u16(current_bank, ofs + 2) == EMPTY) &&
-                (flash.read_u16(current_bank, ofs + 4) == EMPTY) &&
-                (flash.read_u16(current_bank, ofs + 6) == EMPTY)) break;
+            uint32_t mid = (lo + hi) / 2;
+
+            if (is_empty_record(BANK_HEADER_SIZE + mid * RECORD_SIZE)) hi = mid;
+            else lo = mid + 1;
+        }
+
+        uint32_t ofs = BANK_HEADER_SIZE + lo * RECORD_SIZE;
+
+        // Sanity check of next slot. If broken (gap inside data), fall back
+        // to slow scan from the end.
+        if (lo + 1 < slots && !is_empty_record(ofs + RECORD_SIZE))
+        {
+            ofs = BANK_HEADER_SIZE + slots * RECORD_SIZE;
+
+            while (ofs > BANK_HEADER_SIZE && is_empty_record(ofs - RECORD_SIZE)) ofs -= RECORD_SIZE;
         }
 
         return ofs;
     }
 
-    void move_bank(uint8_t from, uint8_t to, uint16_t ignore_addr=UINT16_MAX)
+    // Check if record at `ofs` has more fresh copy. Slow, used only for
+    // addresses out of ADDR_SPACE.
+    bool more_fresh_exists(uint8_t bank, uint32_t ofs, uint16_t addr)
+    {
+        uint32_t i = next_write_offset, group_left = 0;
+
+        while (prev_valid(bank, i, group_left, ofs + RECORD_SIZE))
+        {
+            if (flash.read_u16(bank, i + 2) == addr) return true;
+        }
+
+        return false;
+    }
+
+    bool is_flushing(uint16_t addr)
+    {
+        for (uint32_t i = 0; i < flush_count; i++)
+        {
+            if (queue_addr[i] == addr) return true;
+        }
+        return false;
+    }
+
+    uint32_t read_stored(uint32_t addr, uint32_t dflt)
     {
-        if (!is_clear(to)) flash.erase(to);
+        if (addr < ADDR_SPACE)
+        {
+            uint32_t ofs = index[addr];
+
+            if (!ofs) return dflt;
+
+            uint16_t lo = flash.read_u16(current_bank, ofs + 4);
+            uint16_t hi = flash.read_u16(current_bank, ofs + 6);
+
+            return (hi << 16) + lo;
+        }
+
+        uint32_t ofs = next_write_offset, group_left = 0;
+
+        // Reverse scan, stop on first valid
+        while (prev_valid(current_bank, ofs, group_left))
+        {
+            if (flash.read_u16(current_bank, ofs + 2) != addr) continue;
+
+            uint16_t lo = flash.read_u16(current_bank, ofs + 4);
+            uint16_t hi = flash.read_u16(current_bank, ofs + 6);
 
-        uint32_t dst_end_addr = BANK_HEADER_SIZE;
+            return (hi << 16) + lo;
+        }
 
-        for (uint32_t ofs = BANK_HEADER_SIZE; ofs < next_write_offset; ofs += RECORD_SIZE)
+        return dflt;
+    }
+
+    // Copy fresh records to another bank, skipping those being flushed
+    // (will be overwritten anyway). Single backward pass, first met record
+    // is the most fresh, the rest with the same address are skipped.
+    // New bank is not activated here, pending records should be added first.
+    bool move_bank_tick()
+    {
+        YIELDABLE_WITH(move_frame);
+
+        if (!is_clear(move_to))
         {
-            // Skip invalid records
-            if (flash.read_u16(from, ofs + 0) != COMMIT_MARK) continue;
+            for (erase_ofs = FLASH_DRIVER::BankSize; erase_ofs > 0;)
+            {
+                erase_ofs -= FLASH_DRIVER::EraseSize;
+                lock_begin(EEPROM_LOCK_PER_RECORD);
+                flash.erase(move_to, erase_ofs);
+                lock_end(EEPROM_LOCK_PER_RECORD);
+                YIELD(true);
+            }
+        }
 
-            uint16_t addr = flash.read_u16(from, ofs + 2);
+        move_dst_ofs = BANK_HEADER_SIZE;
+        move_src_ofs = next_write_offset;
+        move_group_left = 0;
 
-            // Skip variable with ignored address
-            if (addr == ignore_addr) continue;
+        for (uint32_t i = 0; i < sizeof(move_copied); i++) move_copied[i] = 0;
 
-            uint16_t lo   = flash.read_u16(from, ofs + 4);
-            uint16_t hi   = flash.read_u16(from, ofs + 6);
+        while (prev_valid(move_from, move_src_ofs, move_group_left))
+        {
+            move_addr = flash.read_u16(move_from, move_src_ofs + 2);
 
-            bool more_fresh_exists = false;
+            if (is_flushing(move_addr)) continue;
 
-            // Check if more fresh record exists
-            for (uint32_t i = ofs + RECORD_SIZE; i < next_write_offset; i += RECORD_SIZE)
+            if (move_addr < ADDR_SPACE)
             {
-                // Skip invalid records
-                if (flash.read_u16(from, i + 0) != COMMIT_MARK) continue;
+                if (move_copied[move_addr >> 3] & (1 << (move_addr & 7))) continue;
+                move_copied[move_addr >> 3] |= (uint8_t)(1 << (move_addr & 7));
+            }
+            else if (more_fresh_exists(move_from, move_src_ofs, move_addr)) continue;
 
-                // Skip different addresses
-                if (flash.read_u16(from, i + 2) != addr) continue;
+            move_lo = flash.read_u16(move_from, move_src_ofs + 4);
+            move_hi = flash.read_u16(move_from, move_src_ofs + 6);
 
-                // More fresh (=> already copied) found
-                more_fresh_exists = true;
-                break;
+            lock_begin(EEPROM_LOCK_PER_RECORD);
+
+            if (WIDE)
+            {
+                write_wide(move_to, move_dst_ofs, data_mark(move_addr, move_lo, move_hi),
+                    move_addr, move_lo, move_hi);
+            }
+            else
+            {
+                flash.write_u16(move_to, move_dst_ofs + 2, move_addr);
+                YIELD(true);
+                flash.write_u16(move_to, move_dst_ofs + 4, move_lo);
+                YIELD(true);
+                flash.write_u16(move_to, move_dst_ofs + 6, move_hi);
+                YIELD(true);
+                flash.write_u16(move_to, move_dst_ofs + 0, COMMIT_MARK);
             }
 
-            if (more_fresh_exists) continue;
+            lock_end(EEPROM_LOCK_PER_RECORD);
+            YIELD(true);
 
-            flash.write_u16(to, dst_end_addr + 2, addr);
-            flash.write_u16(to, dst_end_addr + 4, lo);
-            flash.write_u16(to, dst_end_addr + 6, hi);
-            flash.write_u16(to, dst_end_addr + 0, COMMIT_MARK);
-            dst_end_addr += RECORD_SIZE;
+            move_dst_ofs += RECORD_SIZE;
         }
 
-        // Mark new bank active
-        flash.write_u16(to, 0, BANK_MARK);
-        flash.write_u16(to, 4, VERSION);
-
-        current_bank = to;
-        next_write_offset = dst_end_addr;
+        return false;
+    }
 
-        // Clean old bank in 2 steps to avoid UB: destroy header & run erase
-        flash.write_u16(from, 2, BANK_DIRTY_MARK);
-        flash.write_u16(from, 6, BANK_DIRTY_MARK);
-        flash.erase(from);
+    uint8_t next_bank(uint8_t bank)
+    {
+        return (bank + 1 < FLASH_DRIVER::BankCount) ? bank + 1 : 0;
     }
 
     void init()
     {
         initialized = true;
 
-        if (is_active(0)) current_bank = 0;
-        else if (is_active(1)) current_bank = 1;
+        // Find active bank. Two active banks can exist, if power lost before
+        // old one cleaned. Both have consistent data, use the newer one (not
+        // superseded) and clean the other. Banks without superseded mark
+        // (written by old firmware) are ordered by rotation.
+        uint8_t active = FLASH_DRIVER::BankCount;
+
+        for (uint8_t bank = 0; bank < FLASH_DRIVER::BankCount; bank++)
+        {
+            if (!is_active(bank)) continue;
+
+            if (active == FLASH_DRIVER::BankCount) active = bank;
+            else
+            {
+                uint8_t old;
+
+                if (is_superseded(active) != is_superseded(bank))
+                {
+                    old = is_superseded(active) ? active : bank;
+                }
+                else old = (next_bank(active) == bank) ? active : bank;
+
+                if (old == active) active = bank;
+
+                lock_begin(EEPROM_LOCK_PER_FLUSH);
+                lock_begin(EEPROM_LOCK_PER_RECORD);
+                if (WIDE) erase_bank(old);
+                else write_dirty(old);
+                lock_end(EEPROM_LOCK_PER_RECORD);
+                lock_end(EEPROM_LOCK_PER_FLUSH);
+            }
+        }
+
+        if (active < FLASH_DRIVER::BankCount) current_bank = active;
         else
         {
-            // Both banks have no valid markers => prepare first one
-            if (!is_clear(0)) flash.erase(0);
-            flash.write_u16(0, 0, BANK_MARK);
-            flash.write_u16(0, 4, VERSION);
+            // No banks with valid markers => prepare first one
+            lock_begin(EEPROM_LOCK_PER_FLUSH);
+            lock_begin(EEPROM_LOCK_PER_RECORD);
+            if (!is_clear(0)) erase_bank(0);
+            for (uint8_t step = 0; !write_header_step(0, step); step++) {}
+            lock_end(EEPROM_LOCK_PER_RECORD);
+            lock_end(EEPROM_LOCK_PER_FLUSH);
             current_bank = 0;
         }
 
         next_write_offset = find_write_offset();
+        index_build();
         return;
     }
 
-public:
-    FLASH_DRIVER flash;
-
-    uint32_t read_u32(uint32_t addr, uint32_t dflt)
+    // Flush FSM, see tick()
+    bool flush_tick()
     {
         if (!initialized) init();
 
-        // Reverse scan, stop on first valid
-        for (uint32_t ofs = next_write_offset;;)
+        YIELDABLE_WITH(flush_frame);
+
+        if (!committed_count) return false;
+
+        flush_count = committed_count;
+
+        // Single record is written as usual, group needs extra commit record
+        flush_size = (flush_count == 1 ? 1 : flush_count + 1) * RECORD_SIZE;
+
+        flush_bank = current_bank;
+        flush_start = next_write_offset;
+
+        // With flush lock scope flash stays unlocked until flush completed
+        // (in ASYNC mode it's locked between ticks, see tick()).
+        lock_begin(EEPROM_LOCK_PER_FLUSH);
+
+        // Check free space and copy data to next bank if needed
+        if (next_write_offset + flush_size > FLASH_DRIVER::BankSize)
         {
-            if (ofs <= BANK_HEADER_SIZE) break;
+            move_from = current_bank;
+            move_to = next_bank(current_bank);
 
-            ofs -= RECORD_SIZE;
+            while (move_bank_tick()) YIELD(true);
 
-            if (flash.read_u16(current_bank, ofs + 0) != COMMIT_MARK) continue;
-            if (flash.read_u16(current_bank, ofs + 2) != addr) continue;
+            flush_bank = move_to;
+            flush_start = move_dst_ofs;
+        }
 
-            uint16_t lo = flash.read_u16(current_bank, ofs + 4);
-            uint16_t hi = flash.read_u16(current_bank, ofs + 6);
+        flush_ofs = flush_start;
 
-            return (hi << 16) + lo;
+        // Write data. Single record gets commit mark, group members don't.
+        for (flush_i = 0; flush_i < flush_count; flush_i++)
+        {
+            lock_begin(EEPROM_LOCK_PER_RECORD);
+
+            if (WIDE)
+            {
+                flush_lo = queue_val[flush_i] & 0xFFFF;
+                flush_hi = (uint16_t)(queue_val[flush_i] >> 16) & 0xFFFF;
+
+                write_wide(flush_bank, flush_ofs,
+                    flush_count == 1 ? data_mark(queue_addr[flush_i], flush_lo, flush_hi) : (uint16_t)EMPTY,
+                    queue_addr[flush_i], flush_lo, flush_hi);
+            }
+            else
+            {
+                flash.write_u16(flush_bank, flush_ofs + 2, queue_addr[flush_i]);
+                YIELD(true);
+                flash.write_u16(flush_bank, flush_ofs + 4, queue_val[flush_i] & 0xFFFF);
+                YIELD(true);
+                flash.write_u16(flush_bank, flush_ofs + 6, (uint16_t)(queue_val[flush_i] >> 16) & 0xFFFF);
+
+                if (flush_count == 1)
+                {
+                    YIELD(true);
+                    flash.write_u16(flush_bank, flush_ofs + 0, COMMIT_MARK);
+                }
+            }
+
+            lock_end(EEPROM_LOCK_PER_RECORD);
+
+            flush_ofs += RECORD_SIZE;
+
+            // Last step of single record is commit, no need to yield
+            if (flush_count > 1) YIELD(true);
         }
 
-        return dflt;
+        // Group commit
+        if (flush_count > 1)
+        {
+            lock_begin(EEPROM_LOCK_PER_RECORD);
+
+            if (WIDE) write_wide(flush_bank, flush_ofs, GROUP_COMMIT_MARK, flush_count, (uint16_t)~flush_count, EMPTY);
+            else
+            {
+                flash.write_u16(flush_bank, flush_ofs + 2, flush_count);
+                YIELD(true);
+                flash.write_u16(flush_bank, flush_ofs + 4, (uint16_t)~flush_count);
+                YIELD(true);
+                flash.write_u16(flush_bank, flush_ofs + 0, GROUP_COMMIT_MARK);
+            }
+
+            lock_end(EEPROM_LOCK_PER_RECORD);
+        }
+
+        if (flush_bank == current_bank)
+        {
+            for (uint32_t i = 0; i < flush_count; i++)
+            {
+                uint16_t addr = queue_addr[i];
+                if (addr < ADDR_SPACE) index[addr] = (uint16_t)(flush_start + i * RECORD_SIZE);
+            }
+
+            next_write_offset = flush_start + flush_size;
+        }
+        else
+        {
+            // Mark new bank active. It already has pending records, so both
+            // banks keep consistent data, if power lost before old one
+            // cleaned. Old bank is marked superseded first, to know which
+            // one is newer.
+            YIELD(true);
+            lock_begin(EEPROM_LOCK_PER_RECORD);
+
+            // Already set, if power was lost on previous move attempt
+            if (!is_superseded(move_from))
+            {
+                write_superseded(move_from);
+                YIELD(true);
+            }
+
+            for (flush_i = 0; !write_header_step(flush_bank, (uint8_t)flush_i); flush_i++)
+            {
+                YIELD(true);
+            }
+
+            lock_end(EEPROM_LOCK_PER_RECORD);
+
+            current_bank = flush_bank;
+            next_write_offset = flush_start + flush_size;
+            index_build();
+            YIELD(true);
+
+            // Clean old bank in 2 steps to avoid UB: destroy header & run
+            // erase. Wide flash can't destroy header, superseded mark is
+            // enough.
+            lock_begin(EEPROM_LOCK_PER_RECORD);
+
+            if (!WIDE)
+            {
+                write_dirty(move_from);
+                YIELD(true);
+            }
+
+            for (erase_ofs = FLASH_DRIVER::BankSize; erase_ofs > 0;)
+            {
+                erase_ofs -= FLASH_DRIVER::EraseSize;
+                flash.erase(move_from, erase_ofs);
+                if (erase_ofs) YIELD(true);
+            }
+
+            lock_end(EEPROM_LOCK_PER_RECORD);
+        }
+
+        lock_end(EEPROM_LOCK_PER_FLUSH);
+
+        // Remove written records from queue
+        for (uint32_t i = flush_count; i < queue_count; i++)
+        {
+            queue_addr[i - flush_count] = queue_addr[i];
+            queue_val[i - flush_count] = queue_val[i];
+        }
+
+        queue_count -= flush_count;
+        committed_count -= flush_count;
+        flush_count = 0;
+
+        return true;
     }
 
-    void write_u32(uint32_t addr, uint32_t val)
+public:
+    FLASH_DRIVER flash;
+
+    uint32_t read_u32(uint32_t addr, uint32_t dflt)
     {
         if (!initialized) init();
 
-        uint8_t bank = current_bank;
+        // Pending values have priority, newest first
+        for (uint32_t i = queue_count; i > 0; i--)
+        {
+            if (queue_addr[i - 1] == addr) return queue_val[i - 1];
+        }
+
+        return read_stored(addr, dflt);
+    }
+
+    void write_u32(uint32_t addr, uint32_t val)
+    {
+        if (!initialized) init();
 
         // Don't write the same value
         uint32_t previous = read_u32(addr, val+1);
         if (previous == val) return;
 
-        // Check free space and swap banks if needed
-        if (next_write_offset + RECORD_SIZE > FLASH_DRIVER::BankSize)
+        uint32_t i = committed_count;
+
+        // Replace value, if address already in open group
+        while (i < queue_count && queue_addr[i] != addr) i++;
+
+        // Queue full => flush committed records, keep open group
+        if (i == QUEUE_MAX && committed_count)
+        {
+            flush();
+            i = queue_count;
+        }
+
+        if (i == QUEUE_MAX)
         {
-            move_bank(bank, bank ^ 1, (uint16_t)addr);
-            bank ^= 1;
+            // Group alone doesn't fit queue => split & flush it
+            committed_count = queue_count;
+            flush();
+            i = 0;
         }
 
-        // Write data
-        flash.write_u16(bank, next_write_offset + 2, (uint16_t)addr);
-        flash.write_u16(bank, next_write_offset + 4, val & 0xFFFF);
-        flash.write_u16(bank, next_write_offset + 6, (uint16_t)(val >> 16) & 0xFFFF);
-        flash.write_u16(bank, next_write_offset + 0, COMMIT_MARK);
-        next_write_offset += RECORD_SIZE;
+        queue_addr[i] = (uint16_t)addr;
+        queue_val[i] = val;
+        if (i == queue_count) queue_count++;
+
+        if (!group_open) commit();
+    }
+
+    // Start group of writes. Values become visible in flash all at once
+    // after commit(). Reads see pending values immediately.
+    void begin()
+    {
+        if (!initialized) init();
+
+        group_open = true;
+    }
+
+    void commit()
+    {
+        group_open = false;
+        committed_count = queue_count;
+
+        if (!ASYNC) flush();
+    }
+
+    // Background flush step. Does single flash operation per call. Returns
+    // `false` when nothing to do.
+    //
+    // In ASYNC mode flush is spread over many calls, with other code between
+    // them. Flash is not left unlocked between calls, lock is restored on
+    // resume.
+    bool tick()
+    {
+        if (ASYNC && unlocked) flash.unlock();
+
+        bool pending = flush_tick();
+
+        if (ASYNC && unlocked) flash.lock();
+
+        return pending;
+    }
+
+    // Write all committed records to flash
+    void flush()
+    {
+        while (tick()) {}
     }
 
     float read_float(uint32_t addr, float dflt)
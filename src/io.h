@@ -4,6 +4,8 @@
 
 #include "math/fix16_math.h"
 #include "math/truncated_mean.h"
+#include "math/fix16_recip.h"
+#include "math/fixed.h"
 #include "config_map.h"
 #include "app.h"
 #include "app_hal.h"
@@ -20,6 +22,36 @@ constexpr static int voltage_buffer_length = APP_TICK_FREQUENCY / 48 / 2;
 #define TRIAC_ZERO_TAIL_LENGTH 4
 
 
+// Knob & Vrefint change slowly (tens of ms). Their samples are only summed
+// every tick, and processed (filter, division, scales update) at this
+// reduced rate, Hz.
+#ifndef IO_SLOW_CHANNELS_FREQUENCY
+#define IO_SLOW_CHANNELS_FREQUENCY 500
+#endif
+
+constexpr int io_slow_decimation = APP_TICK_FREQUENCY / IO_SLOW_CHANNELS_FREQUENCY;
+
+static_assert(io_slow_decimation >= 1, "Slow channels frequency should not exceed tick frequency");
+// Slow channels sums of 12-bit samples are scaled by << 4 before division
+static_assert((uint64_t)io_slow_decimation * ADC_FETCH_PER_TICK * (4095 << 4) <= UINT32_MAX,
+    "Slow channels frequency is too low, sums overflow");
+
+
+// Raw 12-bit ADC value, [0..1) of Vref
+typedef Fixed<0, 12> adc_value_t;
+
+// Current per ADC unit, 20 / R * Vref. R >= 1 mOhm (config limit) and
+// Vref < 3.6v => < 72A.
+typedef Fixed<7, 12> current_scale_t;
+
+// Voltage per ADC unit, Vref * 201 < 724v
+typedef Fixed<10, 9> voltage_scale_t;
+
+// ADC value * scale should fit 32-bit multiply
+static_assert(sizeof((adc_value_t() * current_scale_t()).raw) == 4, "Current needs 64-bit multiply");
+static_assert(sizeof((adc_value_t() * voltage_scale_t()).raw) == 4, "Voltage needs 64-bit multiply");
+
+
 struct io_data_t {
     fix16_t voltage = 0;
     fix16_t current = 0;
@@ -49,11 +81,15 @@ public:
     {
         // config shunt resistance - in mOhm (divide by 1000)
         // shunt amplifier gain - 50
-        cfg_shunt_resistance_inv = fix16_from_float(1.0f /
-            (eeprom_float_read(CFG_SHUNT_RESISTANCE_ADDR, CFG_SHUNT_RESISTANCE_DEFAULT)
-            * 50
-            / 1000)
-        );
+        // => 1 / (R * 50 / 1000) = 20 / R
+        cfg_shunt_resistance_inv = fix16_div(F16(20), config.shunt_resistance);
+
+        // Restart slow channels, first update goes at next tick to init
+        // scales
+        slow_knob_sum = 0;
+        slow_v_refin_sum = 0;
+        slow_ticks = 0;
+        slow_period = 1;
     }
 
     // Eat raw adc data, transform and propagate to triac & message queue
@@ -73,42 +109,26 @@ public:
         // Apply filters
         uint16_t adc_voltage = (uint16_t)truncated_mean(adc_voltage_buf, ADC_FETCH_PER_TICK, F16(1.1));
         uint16_t adc_current = (uint16_t)truncated_mean(adc_current_buf, ADC_FETCH_PER_TICK, F16(1.1));
-        uint16_t adc_v_refin = (uint16_t)truncated_mean(adc_v_refin_buf, ADC_FETCH_PER_TICK, F16(1.1));
-        // Skip first filter for knob, o save CPU (second filter is enough)
-        //uint16_t adc_knob = (uint16_t)truncated_mean(adc_knob_buf, ADC_FETCH_PER_TICK, F16(1.1));
-        uint16_t adc_knob = adc_knob_buf[0];
-
-        // Now process the rest...
 
-        // 4096 - maximum value of 12-bit integer
-        // normalize to fix16_t[0.0..1.0]
-        fix16_t knob_new = adc_knob << 4;
+        // Slow channels - only accumulate, process at decimated rate
+        for (int i = 0; i < ADC_FETCH_PER_TICK; i++)
+        {
+            slow_knob_sum += adc_knob_buf[i];
+            slow_v_refin_sum += adc_v_refin_buf[i];
+        }
 
-        // Use additional mean smoother for knob
-        io_data.knob = (prev_knob * 15 + knob_new) >> 4;
-        prev_knob = io_data.knob;
+        if (++slow_ticks >= slow_period) slow_channels_update();
 
+        io_data.knob = knob;
 
-        // Vrefin - internal reference voltage, 1.2v
-        // Vref - ADC reference voltage, equal to ADC supply voltage (~ 3.3v)
-        // adc_vrefin = 1.2 / Vref * 4096
-        fix16_t v_ref = fix16_div(F16(1.2), adc_v_refin << 4);
-
-        // maximum ADC input voltage - Vref
-        // current = adc_current_norm * v_ref / cfg_shunt_resistance
-        io_data.current = fix16_mul(
-            fix16_mul(adc_current << 4, cfg_shunt_resistance_inv),
-            v_ref
-        );
+        // Single 32-bit multiply per value
+        io_data.current = (adc_value_t::from_raw(adc_current) * current_scale).to_fix16();
 
         // Compensate current offset
         io_data.current -= cfg_current_offset;
         if (io_data.current < 0) io_data.current = 0;
 
-        // resistors in voltage divider - [ 2*150 kOhm, 1.5 kOhm ]
-        // (divider ratio => 201)
-        // voltage = adc_voltage * v_ref * (301.5 / 1.5);
-        io_data.voltage = fix16_mul(adc_voltage << 4, v_ref) * 201;
+        io_data.voltage = (adc_value_t::from_raw(adc_voltage) * voltage_scale).to_fix16();
 
 
         check_zero_cross(io_data);
@@ -127,7 +147,16 @@ private:
 
     // Previous iteration values
     fix16_t prev_voltage = 0;
-    fix16_t prev_knob = 0;
+    current_scale_t current_scale;
+    voltage_scale_t voltage_scale;
+
+    // Slow channels data, sums of raw ADC samples since last update
+    uint32_t slow_knob_sum = 0;
+    uint32_t slow_v_refin_sum = 0;
+    uint32_t slow_ticks = 0;
+    uint32_t slow_period = 1;
+    // Cached knob value
+    fix16_t knob = 0;
 
     fix16_t cfg_shunt_resistance_inv = 1; // Fake
 
@@ -151,6 +180,36 @@ private:
     fix16_t voltage_buffer[voltage_buffer_length];
 
 
+    // Mean over decimation period is enough to filter knob & Vrefint noise
+    void slow_channels_update()
+    {
+        uint32_t samples = slow_ticks * ADC_FETCH_PER_TICK;
+
+        // 4096 - maximum value of 12-bit integer
+        // normalize to fix16_t[0.0..1.0]
+        knob = (fix16_t)((slow_knob_sum << 4) / samples);
+
+        // Vrefin - internal reference voltage, 1.2v
+        // Vref - ADC reference voltage, equal to ADC supply voltage (~ 3.3v)
+        // adc_vrefin = 1.2 / Vref * 4096
+        fix16_t v_refin = (fix16_t)((slow_v_refin_sum << 4) / samples);
+        fix16_t v_ref = fix16_div_fast(F16(1.2), v_refin);
+
+        // maximum ADC input voltage - Vref
+        // current = adc_current_norm * v_ref / cfg_shunt_resistance
+        current_scale = current_scale_t::from_fix16(fix16_mul(cfg_shunt_resistance_inv, v_ref));
+
+        // resistors in voltage divider - [ 2*150 kOhm, 1.5 kOhm ]
+        // (divider ratio => 201)
+        // voltage = adc_voltage * v_ref * (301.5 / 1.5);
+        voltage_scale = voltage_scale_t::from_fix16(v_ref * 201);
+
+        slow_knob_sum = 0;
+        slow_v_refin_sum = 0;
+        slow_ticks = 0;
+        slow_period = io_slow_decimation;
+    }
+
     inline void check_zero_cross(io_data_t &io_data)
     {
         if (prev_voltage == 0 && io_data.voltage > 0 && zero_cross_block_cnt == 0)
@@ -0,0 +1,58 @@
+#ifndef __FIX16_CLZ__
+#define __FIX16_CLZ__
+
+//
+// Count leading zeros. Cortex-M0 has no CLZ instruction, binary search is
+// used there.
+//
+
+#include <stdint.h>
+
+#ifndef FIX16_SOFT_CLZ
+#if defined(__ARM_ARCH_6M__)
+#define FIX16_SOFT_CLZ 1
+#else
+#define FIX16_SOFT_CLZ 0
+#endif
+#endif
+
+
+// Count leading zeros by binary search, 5 steps. v should be > 0.
+inline int clz32_soft(uint32_t v)
+{
+    int n = 0;
+
+    if (!(v & 0xFFFF0000)) { n += 16; v <<= 16; }
+    if (!(v & 0xFF000000)) { n += 8; v <<= 8; }
+    if (!(v & 0xF0000000)) { n += 4; v <<= 4; }
+    if (!(v & 0xC0000000)) { n += 2; v <<= 2; }
+    if (!(v & 0x80000000)) { n += 1; }
+    return n;
+}
+
+// Leading zeros of 32-bit value. v should be > 0.
+inline int clz32(uint32_t v)
+{
+#if FIX16_SOFT_CLZ
+    return clz32_soft(v);
+#else
+    return __builtin_clz(v);
+#endif
+}
+
+// Leading zeros of 64-bit value, 64 for 0
+inline int clz64(uint64_t x)
+{
+    if (!x) return 64;
+
+#if FIX16_SOFT_CLZ
+    uint32_t hi = (uint32_t)(x >> 32);
+
+    return hi ? clz32_soft(hi) : 32 + clz32_soft((uint32_t)x);
+#else
+    return __builtin_clzll(x);
+#endif
+}
+
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef __FIX16_INSTRUMENT__
+#define __FIX16_INSTRUMENT__
+
+//
+// Overflow instrumentation of fix16 math, for host builds
+// (`-D FIX16_INSTRUMENT=1`, see `test_native_instrument` env).
+//
+// Firmware is built with FIXMATH_NO_OVERFLOW, so overflows are silent. In
+// instrumented build `fix16_mul()`, `fix16_div()`, `fix16_add()` and
+// `fix16_sub()` between this header and "fix16_instrument_end.h" are
+// checked against 64-bit reference math. Every call site counts calls &
+// overflows, and records ranges of operands and exact result.
+// `FIX16_CHECK_RANGE()` does the same for intermediate values of
+// hand-written integer math.
+//
+// Without FIX16_INSTRUMENT nothing changes, calls go to libfixmath as is.
+//
+// Usage: include this header last in module, and "fix16_instrument_end.h"
+// at module end, to keep macros out of other code.
+//
+
+#include <stdint.h>
+#include "libfixmath/fix16.h"
+
+#ifndef FIX16_INSTRUMENT
+#define FIX16_INSTRUMENT 0
+#endif
+
+
+#if FIX16_INSTRUMENT
+
+#include <stdio.h>
+
+struct Fix16Site
+{
+    const char *file;
+    int line;
+    const char *op;
+
+    uint32_t calls;
+    uint32_t overflows;
+
+    int64_t a_min, a_max;
+    int64_t b_min, b_max;
+    int64_t r_min, r_max;
+
+    Fix16Site *next;
+
+    // Sites are registered on first call
+    Fix16Site(const char *_file, int _line, const char *_op)
+        : file(_file), line(_line), op(_op), next(list())
+    {
+        list() = this;
+        clear();
+    }
+
+    void clear()
+    {
+        calls = 0;
+        overflows = 0;
+        a_min = b_min = r_min = INT64_MAX;
+        a_max = b_max = r_max = INT64_MIN;
+    }
+
+    static Fix16Site *&list()
+    {
+        static Fix16Site *head = nullptr;
+        return head;
+    }
+
+    void track(int64_t a, int64_t b, int64_t r, bool overflow)
+    {
+        calls++;
+        if (overflow) overflows++;
+
+        if (a < a_min) a_min = a;
+        if (a > a_max) a_max = a;
+        if (b < b_min) b_min = b;
+        if (b > b_max) b_max = b;
+        if (r < r_min) r_min = r;
+        if (r > r_max) r_max = r;
+    }
+};
+
+// Static site per macro expansion
+#define FIX16_SITE(op) ([]() -> Fix16Site & { \
+    static Fix16Site site(__FILE__, __LINE__, op); \
+    return site; \
+}())
+
+inline bool fix16_instrument_fits(int64_t v) { return v >= INT32_MIN && v <= INT32_MAX; }
+
+inline fix16_t fix16_instrument_mul(Fix16Site &site, fix16_t a, fix16_t b)
+{
+    // Truncated, the same as FIXMATH_NO_ROUNDING
+    int64_t r = ((int64_t)a * b) >> 16;
+    site.track(a, b, r, !fix16_instrument_fits(r));
+    return fix16_mul(a, b);
+}
+
+inline fix16_t fix16_instrument_div(Fix16Site &site, fix16_t a, fix16_t b)
+{
+    int64_t r = b ? ((int64_t)a * 65536) / b : 0;
+    site.track(a, b, r, !b || !fix16_instrument_fits(r));
+    return fix16_div(a, b);
+}
+
+inline fix16_t fix16_instrument_add(Fix16Site &site, fix16_t a, fix16_t b)
+{
+    int64_t r = (int64_t)a + b;
+    site.track(a, b, r, !fix16_instrument_fits(r));
+    return (fix16_t)(uint32_t)r;
+}
+
+inline fix16_t fix16_instrument_sub(Fix16Site &site, fix16_t a, fix16_t b)
+{
+    int64_t r = (int64_t)a - b;
+    site.track(a, b, r, !fix16_instrument_fits(r));
+    return (fix16_t)(uint32_t)r;
+}
+
+// Value should be in [min..max]. Range is recorded as `a` & result.
+inline void fix16_instrument_check(Fix16Site &site, int64_t val, int64_t min, int64_t max)
+{
+    site.track(val, 0, val, val < min || val > max);
+}
+
+inline uint32_t fix16_instrument_overflows()
+{
+    uint32_t total = 0;
+
+    for (Fix16Site *s = Fix16Site::list(); s; s = s->next) total += s->overflows;
+    return total;
+}
+
+inline void fix16_instrument_reset()
+{
+    for (Fix16Site *s = Fix16Site::list(); s; s = s->next) s->clear();
+}
+
+inline void fix16_instrument_report(FILE *out)
+{
+    for (Fix16Site *s = Fix16Site::list(); s; s = s->next)
+    {
+        if (!s->calls) continue;
+
+        fprintf(out, "%s:%d %s calls %u overflows %u "
+            "a [%lld..%lld] b [%lld..%lld] result [%lld..%lld]\n",
+            s->file, s->line, s->op, s->calls, s->overflows,
+            (long long)s->a_min, (long long)s->a_max,
+            (long long)s->b_min, (long long)s->b_max,
+            (long long)s->r_min, (long long)s->r_max);
+    }
+}
+
+#define FIX16_CHECK_RANGE(val, min, max) \
+    fix16_instrument_check(FIX16_SITE("range"), (int64_t)(val), (min), (max))
+
+#else
+
+#define FIX16_CHECK_RANGE(val, min, max) ((void)0)
+
+#endif
+
+
+#endif
+
+
+// Defined on every include, because "fix16_instrument_end.h" removes them
+#if FIX16_INSTRUMENT
+
+#define fix16_mul(a, b) fix16_instrument_mul(FIX16_SITE("fix16_mul"), (a), (b))
+#define fix16_div(a, b) fix16_instrument_div(FIX16_SITE("fix16_div"), (a), (b))
+#define fix16_add(a, b) fix16_instrument_add(FIX16_SITE("fix16_add"), (a), (b))
+#define fix16_sub(a, b) fix16_instrument_sub(FIX16_SITE("fix16_sub"), (a), (b))
+
+#endif
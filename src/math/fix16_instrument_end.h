@@ -0,0 +1,7 @@
+// End of instrumented code, see "fix16_instrument.h". No include guard,
+// used at the end of every instrumented module.
+
+#undef fix16_mul
+#undef fix16_div
+#undef fix16_add
+#undef fix16_sub
@@ -14,8 +14,5 @@
 //
 fix16_t fix16_sinusize(fix16_t x)
 {
-    fix16_t tmp = fix16_clamp(x, 0, fix16_one - 1);
-
-    // 16 bits - fractional part. Need 9 bit for lookup
-    return (fix16_t)(sinusize_table[ tmp >> (16 - SINUSIZE_TABLE_SIZE_BITS) ]);
+    return sinusize_lookup<SINUSIZE_TABLE_SIZE_BITS, SINUSIZE_TABLE_NON_UNIFORM>(x);
 }
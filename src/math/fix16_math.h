@@ -4,19 +4,45 @@
 
 #include <stdint.h>
 #include "libfixmath/fix16.h"
+#include "fix16_clz.h"
+#include "fix16_recip.h"
 
 
 fix16_t fix16_sinusize(fix16_t x);
 
 //
-// Prior to calclate a/b - reduce bits count to use 32-bits division
-// We do hat for restricted case:
+// Prior to calclate a/b - reduce bits count to use 32-bits division.
+// Both values are shifted right, until `a` fits into 31 bits. Shift is
+// calculated at once, with CLZ.
 //
-// 1. a & b > 0
-// 2. a > b
+// For restricted case: a & b >= 0, a > b. That's the only possible
+// scenario for our needs.
 //
-// That's the only possible scenario for our needs.
+inline void normalize_to_31_bit(uint64_t &a, uint64_t &b)
+{
+    int shift = 33 - clz64(a);
+
+    if (shift > 0)
+    {
+        a >>= shift;
+        b >>= shift;
+    }
+}
+
+//
+// a / b in fix16, for 64-bit sums with the same scale (P / I^2 => R).
+// Cost is bounded: CLZ, 2 shifts and single 32-bit division.
 //
-#define NORMALIZE_TO_31_BIT(a, b) while (a & 0xFFFFFFFF80000000UL) { a >>=1; b >>= 1; }
+// Returns fix16_minimum (the same as `fix16_div()` does) if `b` is 0 or
+// too small comparing to `a`.
+//
+inline fix16_t fix16_ratio64(uint64_t a, uint64_t b)
+{
+    normalize_to_31_bit(a, b);
+
+    if (b == 0) return fix16_minimum;
+
+    return fix16_div_fast((fix16_t)a, (fix16_t)b);
+}
 
 #endif
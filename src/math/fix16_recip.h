@@ -0,0 +1,134 @@
+#ifndef __FIX16_RECIP__
+#define __FIX16_RECIP__
+
+//
+// Division without hardware divider (Cortex-M0), via reciprocal.
+//
+// Divisor is normalized to [0.5..1), reciprocal is seeded from small table
+// and refined with Newton-Raphson iterations, r = r * (2 - d * r). Each
+// iteration doubles precision: seed has ~7 bits, 1 iteration ~14 bits,
+// 2 iterations ~28 bits (more than fix16 has).
+//
+// Reciprocal is kept normalized (mantissa + shift), so precision is the
+// same for any divisor magnitude. Final step corrects last bit, to match
+// `fix16_div()` result. For divisors, which change rarely, prepare
+// reciprocal once & use `fix16_mul_recip()`.
+//
+
+#include <stdint.h>
+
+#include "libfixmath/fix16.h"
+#include "fix16_clz.h"
+
+// Precision (Newton-Raphson iterations), 1..3
+#ifndef FIX16_RECIP_ITERATIONS
+#define FIX16_RECIP_ITERATIONS 2
+#endif
+
+// Use NR division for hot paths on cores without divider. Only M0
+// (F042/F072) benefits. F103 (M3) has hardware UDIV, `fix16_div()` is
+// faster there.
+#ifndef FIX16_DIV_NR
+#if defined(__ARM_ARCH_6M__)
+#define FIX16_DIV_NR 1
+#else
+#define FIX16_DIV_NR 0
+#endif
+#endif
+
+
+struct fix16_recip_t {
+    // 1/|b| in Q30, for |b| normalized to [0.5..1). 0 if b = 0.
+    uint32_t mantissa;
+    // |b|, for final correction
+    uint32_t divisor;
+    // Final right shift of (a * mantissa)
+    uint8_t shift;
+    bool negative;
+};
+
+// Seeds: 1/x in Q15, for x in the middle of each of 64 subranges of [0.5..1)
+struct Fix16RecipSeeds
+{
+    uint16_t seed[64] = {};
+
+    constexpr Fix16RecipSeeds()
+    {
+        // 1 / (0.5 + (i + 0.5) / 128) = 256 / (129 + 2i)
+        for (int i = 0; i < 64; i++) seed[i] = (uint16_t)((256u << 15) / (129 + 2 * i));
+    }
+};
+
+constexpr Fix16RecipSeeds fix16_recip_seeds{};
+
+
+template <int ITERATIONS = FIX16_RECIP_ITERATIONS>
+inline fix16_recip_t fix16_recip_prepare(fix16_t b)
+{
+    fix16_recip_t r = { 0, 0, 0, b < 0 };
+
+    if (b == 0) return r;
+
+    uint32_t d = (uint32_t)(b < 0 ? -b : b);
+
+    r.divisor = d;
+
+    // Normalize to [0.5..1) in Q32
+    int n = clz32(d);
+    d <<= n;
+
+    // Seed by 6 bits after leading one, Q15 => Q30
+    uint32_t m = (uint32_t)fix16_recip_seeds.seed[(d >> 25) & 0x3F] << 15;
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        // e = d * m, ~1.0 in Q30
+        uint32_t e = (uint32_t)(((uint64_t)d * m) >> 32);
+        m = (uint32_t)(((uint64_t)m * ((2u << 30) - e)) >> 30);
+    }
+
+    // a / b = (a << 16) / (d >> n) = a * m * 2^(16 + n - 62)
+    r.mantissa = m;
+    r.shift = (uint8_t)(46 - n);
+    return r;
+}
+
+inline fix16_t fix16_mul_recip(fix16_t a, const fix16_recip_t &r)
+{
+    // The same as `fix16_div()` does
+    if (r.mantissa == 0) return fix16_minimum;
+
+    bool negative = (a < 0) != r.negative;
+    uint64_t abs_a = (uint64_t)(a < 0 ? -(int64_t)a : a);
+    uint64_t res = (abs_a * r.mantissa) >> r.shift;
+
+    // Result can differ from truncated quotient by 1 LSB (NR rounding).
+    // Fix it to match `fix16_div()`.
+    uint64_t num = abs_a << 16;
+
+    if (res * r.divisor > num) res--;
+    else if ((res + 1) * r.divisor <= num) res++;
+
+    if (res > (uint64_t)fix16_maximum) return negative ? fix16_minimum : fix16_maximum;
+
+    return negative ? -(fix16_t)res : (fix16_t)res;
+}
+
+template <int ITERATIONS = FIX16_RECIP_ITERATIONS>
+inline fix16_t fix16_div_nr(fix16_t a, fix16_t b)
+{
+    return fix16_mul_recip(a, fix16_recip_prepare<ITERATIONS>(b));
+}
+
+// Division for hot paths. Uses NR on M0, `fix16_div()` on the rest.
+inline fix16_t fix16_div_fast(fix16_t a, fix16_t b)
+{
+#if FIX16_DIV_NR
+    return fix16_div_nr(a, b);
+#else
+    return fix16_div(a, b);
+#endif
+}
+
+
+#endif
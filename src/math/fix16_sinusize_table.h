@@ -1,529 +1,183 @@
 #ifndef __FIX16_SINUSIZE_TABLE__
 #define __FIX16_SINUSIZE_TABLE__
 
-// This is autogenerated file, with EEPROM map & defaults.
-// Use `npm run sinusize` to regenerate.
+//
+// Compile-time generated table for `fix16_sinusize()`:
+//
+//   f(x) = (asin(2x - 1) * 2 / pi + 1) / 2 = asin(sqrt(x)) * 2 / pi
+//
+// Function is symmetric, f(x) = 1 - f(1 - x), so only [0..0.5] half is
+// stored. Values between knots are linearly interpolated.
+//
+// Derivative is infinite at ends. Uniform knots give big error there,
+// so by default knots are placed at equal steps of output, x_i =
+// sin^2(i * pi / 2 / N), f(x_i) = i / N. That makes them dense near ends.
+// Only x_i are stored, y_i is implicit. Reciprocal of segment widths is
+// stored too, to interpolate without division (M0 has no hardware divide).
+//
+// Max error (65 knots): uniform ~1.4% (130 bytes), non-uniform ~0.2%
+// (386 bytes).
+//
 
 #include <stdint.h>
 
-#define SINUSIZE_TABLE_SIZE 512
-#define SINUSIZE_TABLE_SIZE_BITS 9
-
-
-static const uint16_t sinusize_table[SINUSIZE_TABLE_SIZE] = {
-0,
-1846,
-2612,
-3200,
-3696,
-4134,
-4530,
-4894,
-5234,
-5553,
-5856,
-6144,
-6419,
-6683,
-6938,
-7184,
-7422,
-7653,
-7877,
-8096,
-8309,
-8517,
-8720,
-8919,
-9114,
-9305,
-9493,
-9677,
-9858,
-10036,
-10211,
-10383,
-10553,
-10720,
-10885,
-11048,
-11208,
-11367,
-11523,
-11678,
-11831,
-11982,
-12131,
-12279,
-12426,
-12570,
-12714,
-12856,
-12996,
-13135,
-13274,
-13410,
-13546,
-13680,
-13814,
-13946,
-14077,
-14207,
-14337,
-14465,
-14592,
-14718,
-14844,
-14968,
-15092,
-15215,
-15337,
-15459,
-15579,
-15699,
-15818,
-15936,
-16054,
-16171,
-16287,
-16403,
-16518,
-16633,
-16746,
-16860,
-16972,
-17084,
-17196,
-17307,
-17417,
-17527,
-17636,
-17745,
-17854,
-17962,
-18069,
-18176,
-18282,
-18388,
-18494,
-18599,
-18704,
-18808,
-18912,
-19016,
-19119,
-19221,
-19324,
-19426,
-19527,
-19628,
-19729,
-19830,
-19930,
-20030,
-20129,
-20228,
-20327,
-20426,
-20524,
-20622,
-20719,
-20817,
-20914,
-21011,
-21107,
-21203,
-21299,
-21395,
-21490,
-21585,
-21680,
-21775,
-21869,
-21963,
-22057,
-22150,
-22244,
-22337,
-22430,
-22523,
-22615,
-22707,
-22799,
-22891,
-22983,
-23074,
-23166,
-23257,
-23347,
-23438,
-23529,
-23619,
-23709,
-23799,
-23889,
-23978,
-24067,
-24157,
-24246,
-24335,
-24423,
-24512,
-24600,
-24689,
-24777,
-24865,
-24952,
-25040,
-25128,
-25215,
-25302,
-25389,
-25476,
-25563,
-25650,
-25736,
-25823,
-25909,
-25995,
-26082,
-26167,
-26253,
-26339,
-26425,
-26510,
-26596,
-26681,
-26766,
-26851,
-26936,
-27021,
-27106,
-27191,
-27275,
-27360,
-27444,
-27529,
-27613,
-27697,
-27781,
-27865,
-27949,
-28033,
-28117,
-28200,
-28284,
-28367,
-28451,
-28534,
-28618,
-28701,
-28784,
-28867,
-28950,
-29033,
-29116,
-29199,
-29282,
-29365,
-29447,
-29530,
-29613,
-29695,
-29778,
-29860,
-29943,
-30025,
-30107,
-30190,
-30272,
-30354,
-30436,
-30518,
-30600,
-30683,
-30765,
-30847,
-30929,
-31011,
-31092,
-31174,
-31256,
-31338,
-31420,
-31502,
-31583,
-31665,
-31747,
-31829,
-31910,
-31992,
-32074,
-32156,
-32237,
-32319,
-32401,
-32482,
-32564,
-32646,
-32727,
-32809,
-32890,
-32972,
-33054,
-33135,
-33217,
-33299,
-33380,
-33462,
-33544,
-33626,
-33707,
-33789,
-33871,
-33953,
-34034,
-34116,
-34198,
-34280,
-34362,
-34444,
-34525,
-34607,
-34689,
-34771,
-34853,
-34936,
-35018,
-35100,
-35182,
-35264,
-35346,
-35429,
-35511,
-35593,
-35676,
-35758,
-35841,
-35923,
-36006,
-36089,
-36171,
-36254,
-36337,
-36420,
-36503,
-36586,
-36669,
-36752,
-36835,
-36918,
-37002,
-37085,
-37169,
-37252,
-37336,
-37419,
-37503,
-37587,
-37671,
-37755,
-37839,
-37923,
-38007,
-38092,
-38176,
-38261,
-38345,
-38430,
-38515,
-38600,
-38685,
-38770,
-38855,
-38940,
-39026,
-39111,
-39197,
-39283,
-39369,
-39454,
-39541,
-39627,
-39713,
-39800,
-39886,
-39973,
-40060,
-40147,
-40234,
-40321,
-40408,
-40496,
-40584,
-40671,
-40759,
-40847,
-40936,
-41024,
-41113,
-41201,
-41290,
-41379,
-41469,
-41558,
-41647,
-41737,
-41827,
-41917,
-42007,
-42098,
-42189,
-42279,
-42370,
-42462,
-42553,
-42645,
-42737,
-42829,
-42921,
-43013,
-43106,
-43199,
-43292,
-43386,
-43479,
-43573,
-43667,
-43761,
-43856,
-43951,
-44046,
-44141,
-44237,
-44333,
-44429,
-44525,
-44622,
-44719,
-44817,
-44914,
-45012,
-45110,
-45209,
-45308,
-45407,
-45506,
-45606,
-45706,
-45807,
-45908,
-46009,
-46110,
-46212,
-46315,
-46417,
-46520,
-46624,
-46728,
-46832,
-46937,
-47042,
-47148,
-47254,
-47360,
-47467,
-47574,
-47682,
-47791,
-47900,
-48009,
-48119,
-48229,
-48340,
-48452,
-48564,
-48676,
-48790,
-48903,
-49018,
-49133,
-49249,
-49365,
-49482,
-49600,
-49718,
-49837,
-49957,
-50077,
-50199,
-50321,
-50444,
-50568,
-50692,
-50818,
-50944,
-51071,
-51199,
-51329,
-51459,
-51590,
-51722,
-51856,
-51990,
-52126,
-52262,
-52401,
-52540,
-52680,
-52822,
-52966,
-53110,
-53257,
-53405,
-53554,
-53705,
-53858,
-54013,
-54169,
-54328,
-54488,
-54651,
-54816,
-54983,
-55153,
-55325,
-55500,
-55678,
-55859,
-56043,
-56231,
-56422,
-56617,
-56816,
-57019,
-57227,
-57440,
-57659,
-57883,
-58114,
-58352,
-58598,
-58853,
-59117,
-59392,
-59680,
-59983,
-60302,
-60642,
-61006,
-61402,
-61840,
-62336,
-62924,
-63690,
-65535
+#include "libfixmath/fix16.h"
+
+// Table has (1 << SINUSIZE_TABLE_SIZE_BITS) segments for [0..0.5] range
+#define SINUSIZE_TABLE_SIZE_BITS 6
+// 1 - knots dense near ends, 0 - uniform knots
+#define SINUSIZE_TABLE_NON_UNIFORM 1
+
+
+namespace sinusize_gen {
+
+constexpr double pi = 3.14159265358979323846;
+
+// Taylor series, good enough for [0..pi/2]
+constexpr double sin(double x)
+{
+    double term = x, sum = x;
+    for (int n = 1; n < 15; n++)
+    {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double cos(double x)
+{
+    double term = 1, sum = 1;
+    for (int n = 1; n < 15; n++)
+    {
+        term *= -x * x / ((2 * n - 1) * (2 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double sqrt(double x)
+{
+    if (x <= 0) return 0;
+
+    double y = x < 1 ? 1 : x;
+    for (int i = 0; i < 60; i++) y = (y + x / y) / 2;
+    return y;
+}
+
+// Newton's method, for [0..sqrt(0.5)] only (cos stays far from 0)
+constexpr double asin(double x)
+{
+    double y = x;
+    for (int i = 0; i < 20; i++) y -= (sin(y) - x) / cos(y);
+    return y;
+}
+
+constexpr uint16_t to_u16(double x)
+{
+    return (uint16_t)(x * 65536 + 0.5);
+}
+
+} // namespace sinusize_gen
+
+
+template <unsigned BITS, bool NON_UNIFORM>
+struct SinusizeTable
+{
+    static constexpr int SEGMENTS = 1 << BITS;
+
+    // Non-uniform: x of knots, uniform: y of knots. All in [0..0.5].
+    uint16_t knots[SEGMENTS + 1] = {};
+    // Non-uniform only: 2^31 / segment width. Segment width < 2^11, so
+    // (x - x0) * inv_dx fits 32 bits.
+    uint32_t inv_dx[NON_UNIFORM ? SEGMENTS : 1] = {};
+
+    constexpr SinusizeTable()
+    {
+        for (int i = 0; i <= SEGMENTS; i++)
+        {
+            if (NON_UNIFORM)
+            {
+                double s = sinusize_gen::sin(sinusize_gen::pi / 4 * i / SEGMENTS);
+                knots[i] = sinusize_gen::to_u16(s * s);
+            }
+            else
+            {
+                double x = 0.5 * i / SEGMENTS;
+                knots[i] = sinusize_gen::to_u16(
+                    sinusize_gen::asin(sinusize_gen::sqrt(x)) * 2 / sinusize_gen::pi);
+            }
+        }
+
+        if (NON_UNIFORM)
+        {
+            for (int i = 0; i < SEGMENTS; i++)
+            {
+                uint32_t dx = knots[i + 1] - knots[i];
+                inv_dx[i] = (uint32_t)(((1ULL << 31) + dx / 2) / dx);
+            }
+        }
+    }
 };
 
+template <unsigned BITS, bool NON_UNIFORM>
+constexpr SinusizeTable<BITS, NON_UNIFORM> sinusize_table{};
+
+
+// Lookup for x in [0..0.5]
+template <unsigned BITS>
+inline fix16_t sinusize_half(fix16_t x, const SinusizeTable<BITS, true> &table)
+{
+    // Binary search of last knot <= x
+    uint32_t lo = 0, hi = SinusizeTable<BITS, true>::SEGMENTS;
+
+    while (hi - lo > 1)
+    {
+        uint32_t mid = (lo + hi) >> 1;
+        if (table.knots[mid] <= x) lo = mid;
+        else hi = mid;
+    }
+
+    uint32_t x0 = table.knots[lo];
+
+    // (x - x0) <= dx, product is <= 2^31 + dx
+    uint32_t t = (((uint32_t)x - x0) * table.inv_dx[lo]) >> 15;
+
+    if (t > 65536) t = 65536;
+
+    // y = (lo + t) / (2 * SEGMENTS)
+    return (fix16_t)(((lo << 16) + t) >> (BITS + 1));
+}
+
+template <unsigned BITS>
+inline fix16_t sinusize_half(fix16_t x, const SinusizeTable<BITS, false> &table)
+{
+    // Segment width is 0.5 / SEGMENTS
+    enum { SHIFT = 15 - BITS };
+
+    uint32_t idx = (uint32_t)x >> SHIFT;
+
+    if (idx >= SinusizeTable<BITS, false>::SEGMENTS) return table.knots[SinusizeTable<BITS, false>::SEGMENTS];
+
+    int32_t y0 = table.knots[idx];
+    int32_t dy = table.knots[idx + 1] - y0;
+    int32_t frac = x & ((1 << SHIFT) - 1);
+
+    return (fix16_t)(y0 + ((dy * frac) >> SHIFT));
+}
+
+template <unsigned BITS, bool NON_UNIFORM>
+inline fix16_t sinusize_lookup(fix16_t x)
+{
+    fix16_t tmp = fix16_clamp(x, 0, fix16_one - 1);
+
+    if (tmp > fix16_one / 2)
+    {
+        return fix16_one - sinusize_half(fix16_one - tmp, sinusize_table<BITS, NON_UNIFORM>);
+    }
+
+    return sinusize_half(tmp, sinusize_table<BITS, NON_UNIFORM>);
+}
+
 
 #endif
@@ -0,0 +1,123 @@
+#ifndef __FIXED__
+#define __FIXED__
+
+//
+// Signed fixed point value with compile-time Q format (INT_BITS.FRAC_BITS,
+// plus sign).
+//
+// - Storage is int32_t if value fits 32 bits, int64_t otherwise.
+// - Multiply is exact, result format is Q(I1 + I2).(F1 + F2). So 32-bit
+//   multiply is used when product fits, and 64-bit one only when needed.
+//   Format too wide for 64 bits fails to compile.
+// - Format conversions are shifts with compile-time direction & size.
+//
+// Value range is not checked at runtime. Caller chooses INT_BITS by known
+// physical range.
+//
+
+#include <stdint.h>
+
+#include "libfixmath/fix16.h"
+
+
+template <bool WIDE> struct fixed_raw { typedef int32_t type; };
+template <> struct fixed_raw<true> { typedef int64_t type; };
+
+// Shift left for positive `S`, right for negative
+template <int S, typename T>
+constexpr T fixed_shift(T v)
+{
+    return S >= 0 ? (T)(v * ((T)1 << (S >= 0 ? S : 0))) : (T)(v >> (S < 0 ? -S : 0));
+}
+
+constexpr int fixed_log2_ceil(uint32_t x)
+{
+    int bits = 0;
+    while (((uint64_t)1 << bits) < x) bits++;
+    return bits;
+}
+
+
+template <int INT_BITS, int FRAC_BITS>
+class Fixed
+{
+    static_assert(INT_BITS >= 0 && FRAC_BITS >= 0, "Negative bits count");
+    static_assert(INT_BITS + FRAC_BITS < 64, "Fixed format doesn't fit 64 bits");
+
+public:
+    enum { INT = INT_BITS, FRAC = FRAC_BITS, BITS = INT_BITS + FRAC_BITS + 1 };
+
+    typedef typename fixed_raw<(BITS > 32)>::type raw_t;
+
+    raw_t raw = 0;
+
+    static constexpr Fixed from_raw(raw_t r)
+    {
+        Fixed f;
+        f.raw = r;
+        return f;
+    }
+
+    // For constants. Rounds the same way as `F16()`.
+    static constexpr Fixed from_double(double v)
+    {
+        return from_raw((raw_t)(v * ((uint64_t)1 << FRAC_BITS) + (v >= 0 ? 0.5 : -0.5)));
+    }
+
+    static constexpr Fixed from_fix16(fix16_t v)
+    {
+        return from_raw(fixed_shift<FRAC_BITS - 16>((raw_t)v));
+    }
+
+    constexpr fix16_t to_fix16() const
+    {
+        return (fix16_t)fixed_shift<16 - FRAC_BITS>(raw);
+    }
+
+    // Convert to other format. Fractional bits are truncated, integer bits
+    // are not checked.
+    template <int I, int F>
+    constexpr Fixed<I, F> to() const
+    {
+        typedef typename Fixed<I, F>::raw_t R;
+
+        return Fixed<I, F>::from_raw(F >= FRAC_BITS ?
+            fixed_shift<F - FRAC_BITS>((R)raw) :
+            (R)fixed_shift<F - FRAC_BITS>(raw));
+    }
+
+    constexpr Fixed operator+(Fixed b) const { return from_raw(raw + b.raw); }
+    constexpr Fixed operator-(Fixed b) const { return from_raw(raw - b.raw); }
+
+    constexpr bool operator<(Fixed b) const { return raw < b.raw; }
+    constexpr bool operator>(Fixed b) const { return raw > b.raw; }
+};
+
+
+// Exact product. Intermediate & result types are the narrowest to fit.
+template <int I1, int F1, int I2, int F2>
+constexpr Fixed<I1 + I2, F1 + F2> operator*(Fixed<I1, F1> a, Fixed<I2, F2> b)
+{
+    typedef typename Fixed<I1 + I2, F1 + F2>::raw_t R;
+
+    return Fixed<I1 + I2, F1 + F2>::from_raw((R)a.raw * (R)b.raw);
+}
+
+
+// Sum of up to MAX_COUNT values of type T. Integer part is extended to
+// guarantee no overflow.
+template <typename T, uint32_t MAX_COUNT>
+class FixedSum
+{
+public:
+    typedef Fixed<T::INT + fixed_log2_ceil(MAX_COUNT), T::FRAC> sum_t;
+
+    sum_t sum;
+
+    void reset() { sum.raw = 0; }
+
+    void add(T v) { sum.raw += v.raw; }
+};
+
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef __KNOB_CURVE__
+#define __KNOB_CURVE__
+
+//
+// Knob => normalized speed transfer curve.
+//
+// Curve is built on config load as table of (2^BITS + 1) knots, with output
+// values already scaled to [min..max] speed limits. Evaluation is single
+// lookup with linear interpolation, no divisions.
+//
+// Optional hysteresis (backlash) is applied to knob value first, so ADC
+// noise does not reach regulator. At zero knob position held value equals
+// hysteresis, so it's limited to half of dead zone, to stop motor reliably.
+//
+
+#include <stdint.h>
+
+#include "libfixmath/fix16.h"
+#include "fixed.h"
+
+#define KNOB_CURVE_SIZE_BITS 5
+
+// Number of user-defined points, evenly spaced over active knob range
+// (after dead zone)
+#define KNOB_CURVE_POINTS_COUNT 5
+
+// e^(k*x) curve steepness. Bigger value => finer control at low speed.
+#define KNOB_CURVE_EXP_K 3.0
+
+enum knob_curve_type_t {
+    KNOB_CURVE_LINEAR,
+    KNOB_CURVE_EXPONENTIAL,
+    KNOB_CURVE_USER_POINTS
+};
+
+
+template <int BITS>
+class KnobCurveTemplate
+{
+    enum { SIZE = 1 << BITS, FRAC_SHIFT = 16 - BITS };
+
+public:
+    // Knob value in [0..1) (after dead zone), scale < 4. Both fit single
+    // 32-bit multiply.
+    typedef Fixed<0, 16> knob_t;
+    typedef Fixed<2, 13> scale_t;
+
+    static_assert(sizeof((knob_t() * scale_t()).raw) == 4, "64-bit multiply in knob normalization");
+
+    // dead_zone, hysteresis, out_min, out_max - normalized.
+    // points - KNOB_CURVE_POINTS_COUNT values in [0..1], for user curve.
+    void configure(
+        knob_curve_type_t type,
+        fix16_t dead_zone,
+        fix16_t hysteresis,
+        fix16_t out_min,
+        fix16_t out_max,
+        const fix16_t *points)
+    {
+        this->dead_zone = dead_zone;
+        this->hysteresis = fix16_clamp(hysteresis, 0, dead_zone / 2);
+        knob_top = fix16_one - this->hysteresis;
+
+        scale = scale_t::from_fix16(fix16_clamp(
+            fix16_div(fix16_one, fix16_one - this->hysteresis - dead_zone),
+            0,
+            F16(3.999)
+        ));
+
+        for (int i = 0; i <= SIZE; i++)
+        {
+            fix16_t x = (fix16_t)(i << FRAC_SHIFT);
+            fix16_t shape = x;
+
+            if (type == KNOB_CURVE_EXPONENTIAL) shape = shape_exp(x);
+            else if (type == KNOB_CURVE_USER_POINTS) shape = shape_points(i, points);
+
+            knots[i] = out_min + fix16_mul(fix16_clamp(shape, 0, fix16_one), out_max - out_min);
+        }
+
+        reset();
+    }
+
+    void reset()
+    {
+        knob_held = 0;
+    }
+
+    fix16_t map(fix16_t knob)
+    {
+        if (knob > knob_held + hysteresis) knob_held = knob - hysteresis;
+        else if (knob < knob_held - hysteresis) knob_held = knob + hysteresis;
+
+        if (knob_held < dead_zone) return 0;
+        if (knob_held >= knob_top) return knots[SIZE];
+
+        fix16_t x = (knob_t::from_fix16(knob_held - dead_zone) * scale).to_fix16();
+
+        if (x >= fix16_one) return knots[SIZE];
+
+        int idx = x >> FRAC_SHIFT;
+        int32_t frac = x & ((1 << FRAC_SHIFT) - 1);
+
+        // Knots step is small enough (< 2^19 for limits < 60 and steepest
+        // curve), product fits 32 bits.
+        return knots[idx] + (((knots[idx + 1] - knots[idx]) * frac) >> FRAC_SHIFT);
+    }
+
+private:
+    fix16_t knots[SIZE + 1];
+
+    fix16_t dead_zone = 0;
+    fix16_t hysteresis = 0;
+    // Max knob value after hysteresis
+    fix16_t knob_top = fix16_one;
+    scale_t scale = scale_t::from_double(1.0);
+
+    fix16_t knob_held = 0;
+
+    // (e^(k*x) - 1) / (e^k - 1)
+    static fix16_t shape_exp(fix16_t x)
+    {
+        return fix16_div(
+            fix16_exp(fix16_mul(F16(KNOB_CURVE_EXP_K), x)) - fix16_one,
+            fix16_exp(F16(KNOB_CURVE_EXP_K)) - fix16_one
+        );
+    }
+
+    // Piecewise linear by user points
+    static fix16_t shape_points(int i, const fix16_t *points)
+    {
+        // Position in units of knots step
+        int pos = i * (KNOB_CURVE_POINTS_COUNT - 1);
+        int seg = pos >> BITS;
+
+        if (seg >= KNOB_CURVE_POINTS_COUNT - 1) return points[KNOB_CURVE_POINTS_COUNT - 1];
+
+        int32_t frac = pos & (SIZE - 1);
+
+        return points[seg] + (((points[seg + 1] - points[seg]) * frac) >> BITS);
+    }
+};
+
+typedef KnobCurveTemplate<KNOB_CURVE_SIZE_BITS> KnobCurve;
+
+
+#endif
@@ -5,9 +5,13 @@
 // overflow.
 //
 // Useful for interrupt-driven data fill, to minimize possible locks.
-// Worst case ~ scan of 1/2 collected elements.
 //
 // How it works (in general): https://stackoverflow.com/a/15319593/1031804
+//
+// 2 binary heaps (max-heap for low half, min-heap for high half), O(log n)
+// per `add()`, O(1) `result()`.
+
+#include <stdint.h>
 
 template <typename T, int SIZE>
 class MedianIteratorTemplate {
@@ -21,156 +25,301 @@ public:
     {
         heap_lo_len = 0;
         heap_hi_len = 0;
-        heap_lo_max_idx = 0;
-        heap_hi_min_idx = 0;
     }
 
     T result()
     {
         int total_len = heap_lo_len + heap_hi_len;
 
-        // If not enougth data, create result manually
-        switch (total_len){
-            case 0: return 0;
-            case 1: return heap_lo[0];
-            case 2: return (heap_lo[0] + heap_hi[0]) / 2;
-        }
+        if (total_len == 0) return 0;
 
-        if (total_len & 0x01)
-        {
-            return (heap_lo_len > heap_hi_len) ? heap_lo[heap_lo_max_idx] : heap_hi[heap_hi_min_idx];
-        }
-        return (heap_lo[heap_lo_max_idx] + heap_hi[heap_hi_min_idx]) / 2;
+        // Low heap holds extra element for odd length
+        if (total_len & 0x01) return heap_lo()[0];
+
+        return (heap_lo()[0] + heap_hi()[0]) / 2;
     }
 
     void add(T val) {
-        // Process special cases
-        switch (heap_lo_len + heap_hi_len) {
-            case 0:
-                // First data => push to low heap
-                heap_lo[0] = val;
-                heap_lo_len = 1;
-                return;
-
-            case 1:
-                // Second data => low and high heaps should contain per 1 element each
-                // at the end. Reorder if needed.
-                if (val < heap_lo[0])
-                {
-                  heap_hi[0] = heap_lo[0];
-                  heap_lo[0] = val;
-                }
-                else heap_hi[0] = val;
-
-                heap_hi_len = 1;
-                return;
-
-            case SIZE:
-                // If all buffers occupied - stop accepting new data
-                return;
-        }
+        // If all buffers occupied - stop accepting new data
+        if (heap_lo_len + heap_hi_len >= SIZE) return;
 
-        // Now we have enough to start with safe min/max searches.
-        T lo_max_val = heap_lo[heap_lo_max_idx];
-        T hi_min_val = heap_hi[heap_hi_min_idx];
+        // Keep balance: heap_lo_len == heap_hi_len or heap_hi_len + 1
 
-        if (val < lo_max_val)
+        if (heap_lo_len == 0)
+        {
+            heap_lo_push(val);
+            return;
+        }
+
+        if (val < heap_lo()[0])
         {
             // New value must go to low heap
             if (heap_lo_len > heap_hi_len)
             {
-                // Ups... curent size "too big" => transfer existing max to high heap
+                // Low heap is "too big" => transfer existing max to high heap
                 // (and put new value to it's place)
-                heap_hi[heap_hi_len] = lo_max_val;
-                heap_hi_min_idx = heap_hi_len;
-                heap_hi_len++;
-
-                // Need refresh max after such update
-                heap_lo[heap_lo_max_idx] = val;
-                heap_lo_max_idx = get_heap_lo_max_idx();
-            }
-            else
-            {
-                // Just add value to low heap
-                heap_lo[heap_lo_len++] = val;
+                heap_hi_push(heap_lo()[0]);
+                heap_lo_replace_top(val);
             }
+            else heap_lo_push(val);
+
+            return;
         }
-        else if (val >= hi_min_val)
+
+        if (heap_lo_len > heap_hi_len) heap_hi_push(val);
+        else if (heap_hi_len && val > heap_hi()[0])
         {
-            // New value must go to high heap
-            if (heap_hi_len > heap_lo_len)
-            {
-                // Ups... curent size "too big" => transfer existing min to low heap
-                // (and put new value to it's place)
-                heap_lo[heap_lo_len] = hi_min_val;
-                heap_lo_max_idx = heap_lo_len;
-                heap_lo_len++;
+            // New value must go to high heap, but it's full => transfer
+            // existing min to low heap
+            heap_lo_push(heap_hi()[0]);
+            heap_hi_replace_top(val);
+        }
+        else heap_lo_push(val);
+    }
 
-                // Need refresh min after such update
-                heap_hi[heap_hi_min_idx] = val;
-                heap_hi_min_idx = get_heap_hi_min_idx();
-            }
-            else
-            {
-                // Just add value to heap_hi
-                heap_hi[heap_hi_len++] = val;
-            }
+private:
+    // Max-heap for low half, then min-heap for high half. Separate arrays
+    // of exact size (and empty high heap for SIZE 1) make gcc report false
+    // `-Warray-bounds` / `-Wstringop-overflow` for small SIZE.
+    T heaps[SIZE > 1 ? SIZE : 2];
+    int heap_lo_len;
+    int heap_hi_len;
+
+    T *heap_lo() { return heaps; }
+    T *heap_hi() { return heaps + (SIZE + 1) / 2; }
+
+    void heap_lo_push(T val)
+    {
+        int i = heap_lo_len++;
+
+        while (i > 0)
+        {
+            int parent = (i - 1) >> 1;
+            if (!(heap_lo()[parent] < val)) break;
+            heap_lo()[i] = heap_lo()[parent];
+            i = parent;
+        }
+        heap_lo()[i] = val;
+    }
+
+    void heap_hi_push(T val)
+    {
+        int i = heap_hi_len++;
+
+        while (i > 0)
+        {
+            int parent = (i - 1) >> 1;
+            if (!(val < heap_hi()[parent])) break;
+            heap_hi()[i] = heap_hi()[parent];
+            i = parent;
+        }
+        heap_hi()[i] = val;
+    }
+
+    void heap_lo_replace_top(T val)
+    {
+        int i = 0;
+
+        for (;;)
+        {
+            int child = 2 * i + 1;
+            if (child >= heap_lo_len) break;
+            if (child + 1 < heap_lo_len && heap_lo()[child] < heap_lo()[child + 1]) child++;
+            if (!(val < heap_lo()[child])) break;
+            heap_lo()[i] = heap_lo()[child];
+            i = child;
+        }
+        heap_lo()[i] = val;
+    }
+
+    void heap_hi_replace_top(T val)
+    {
+        int i = 0;
+
+        for (;;)
+        {
+            int child = 2 * i + 1;
+            if (child >= heap_hi_len) break;
+            if (child + 1 < heap_hi_len && heap_hi()[child + 1] < heap_hi()[child]) child++;
+            if (!(heap_hi()[child] < val)) break;
+            heap_hi()[i] = heap_hi()[child];
+            i = child;
+        }
+        heap_hi()[i] = val;
+    }
+};
+
+
+// Sliding window median of last SIZE values, O(log n) per `add()`.
+//
+// Values are kept in ring buffer. Two heaps (max-heap for low half, min-heap
+// for high half) store ring slots, and every slot knows its heap position.
+// So the oldest value can be replaced in place, with sift of single element.
+
+template <typename T, int SIZE>
+class SlidingMedianTemplate {
+
+    static_assert(SIZE > 0 && SIZE < 128, "Window size should be 1..127");
+
+public:
+    SlidingMedianTemplate() {
+      reset();
+    }
+
+    void reset()
+    {
+        count = 0;
+        head = 0;
+        heap_lo_len = 0;
+        heap_hi_len = 0;
+    }
+
+    // `true` when window filled & result has no startup transient
+    bool is_full() { return count >= SIZE; }
+
+    T result()
+    {
+        if (count == 0) return 0;
+
+        // Low heap holds extra element for odd length
+        if (count & 0x01) return buf[heap<true>()[0]];
+
+        return (buf[heap<true>()[0]] + buf[heap<false>()[0]]) / 2;
+    }
+
+    void add(T val)
+    {
+        int slot = head;
+
+        head = (head + 1 < SIZE) ? head + 1 : 0;
+        buf[slot] = val;
+
+        if (count < SIZE)
+        {
+            count++;
+            insert(slot);
+            return;
+        }
+
+        // Window is full => slot had the oldest value, fix it's position
+        int p = pos[slot];
+
+        if (p >= 0)
+        {
+            sift_up<true>(p);
+            sift_down<true>(pos[slot]);
         }
         else
         {
-            // Value is somewhere "between" heaps => try push to lower heap,
-            // if it's size is not too big
-            if (heap_lo_len > heap_hi_len)
-            {
-                // No space in low heap => push to high one
-                heap_hi[heap_hi_len] = val;
-                heap_hi_min_idx = heap_hi_len;
-                heap_hi_len++;
-            }
-            else
-            {
-                heap_lo[heap_lo_len] = val;
-                heap_lo_max_idx = heap_lo_len;
-                heap_lo_len++;
-            }
+            sift_up<false>(-p - 1);
+            sift_down<false>(-pos[slot] - 1);
+        }
+
+        // New value may violate order between heaps => swap tops
+        if (heap_hi_len && buf[heap<false>()[0]] < buf[heap<true>()[0]])
+        {
+            uint8_t lo_top = heap<true>()[0];
+
+            place<true>(0, heap<false>()[0]);
+            place<false>(0, lo_top);
+            sift_down<true>(0);
+            sift_down<false>(0);
         }
     }
 
 private:
-    T heap_lo[SIZE / 2 + (SIZE & 1)];
-    int heap_lo_len;
-    int heap_lo_max_idx;
+    T buf[SIZE];
+    // Heap position of each slot: >= 0 in low heap, < 0 in high one.
+    int8_t pos[SIZE];
 
-    T heap_hi[SIZE / 2 + (SIZE & 1)];
+    // Both heaps in single array, low one first (see above).
+    enum { HEAP_HI_OFFSET = (SIZE + 1) / 2 };
+    uint8_t heaps[SIZE > 1 ? SIZE : 2];
+
+    int count;
+    int head;
+    int heap_lo_len;
     int heap_hi_len;
-    int heap_hi_min_idx;
 
-    int get_heap_lo_max_idx()
+    // Window not filled yet => add new slot, keep heaps balanced
+    void insert(int slot)
     {
-        int i, idx;
-        i = idx = heap_lo_len - 1;
-        T val = heap_lo[i];
+        T val = buf[slot];
 
-        while (i--) {
-            int tmp = heap_lo[i];
-            if (tmp > val) { val = tmp; idx = i; }
+        if (heap_lo_len == 0) push<true>(slot);
+        else if (val < buf[heap<true>()[0]])
+        {
+            if (heap_lo_len > heap_hi_len)
+            {
+                push<false>(heap<true>()[0]);
+                place<true>(0, slot);
+                sift_down<true>(0);
+            }
+            else push<true>(slot);
         }
+        else if (heap_lo_len > heap_hi_len) push<false>(slot);
+        else if (heap_hi_len && buf[heap<false>()[0]] < val)
+        {
+            push<true>(heap<false>()[0]);
+            place<false>(0, slot);
+            sift_down<false>(0);
+        }
+        else push<true>(slot);
+    }
 
-        return idx;
+    template <bool LO> uint8_t *heap() { return LO ? heaps : heaps + HEAP_HI_OFFSET; }
+    template <bool LO> int &heap_len() { return LO ? heap_lo_len : heap_hi_len; }
+
+    // `true` if slot `a` should be closer to heap top than `b`
+    template <bool LO> bool above(int a, int b)
+    {
+        return LO ? buf[b] < buf[a] : buf[a] < buf[b];
+    }
+
+    template <bool LO> void place(int i, int slot)
+    {
+        heap<LO>()[i] = (uint8_t)slot;
+        pos[slot] = (int8_t)(LO ? i : -i - 1);
+    }
+
+    template <bool LO> void push(int slot)
+    {
+        int i = heap_len<LO>()++;
+        place<LO>(i, slot);
+        sift_up<LO>(i);
     }
 
-    int get_heap_hi_min_idx()
+    template <bool LO> void sift_up(int i)
     {
-        int i, idx;
-        i = idx = heap_hi_len - 1;
-        T val = heap_hi[i];
+        uint8_t *h = heap<LO>();
+        int slot = h[i];
 
-        while (i--) {
-            int tmp = heap_hi[i];
-            if (tmp < val) { val = tmp; idx = i; }
+        while (i > 0)
+        {
+            int parent = (i - 1) >> 1;
+            if (!above<LO>(slot, h[parent])) break;
+            place<LO>(i, h[parent]);
+            i = parent;
         }
+        place<LO>(i, slot);
+    }
 
-        return idx;
+    template <bool LO> void sift_down(int i)
+    {
+        uint8_t *h = heap<LO>();
+        int len = heap_len<LO>();
+        int slot = h[i];
+
+        for (;;)
+        {
+            int child = 2 * i + 1;
+            if (child >= len) break;
+            if (child + 1 < len && above<LO>(h[child + 1], h[child])) child++;
+            if (!above<LO>(h[child], slot)) break;
+            place<LO>(i, h[child]);
+            i = child;
+        }
+        place<LO>(i, slot);
     }
 };
 
@@ -11,6 +11,9 @@
 // 1. Apply median filter first (if enabled).
 // 2. Test deviation of median filter output.
 //
+// Min/max of window are tracked with monotonic deques, and sum is updated
+// on push. So checks are O(1) for any FILTER_LENGTH.
+//
 template <fix16_t PRECISION_IN_PERCENTS, uint8_t MEDIAN_LEN = 1, int32_t MAX_TICKS = -1, uint8_t FILTER_LENGTH = 3>
 class StabilityFilterTemplate {
 
@@ -23,6 +26,11 @@ public:
     {
         head_idx = 0;
         data_count = 0;
+        seq = 0;
+        sum = 0;
+        min_q.reset();
+        max_q.reset();
+        for (int i = 0; i < FILTER_LENGTH; i++) data[i] = 0;
         median_filter.reset();
         ticks_count = 0;
         median_count = 0;
@@ -32,9 +40,7 @@ public:
         // Skip median filter if too short
         if (MEDIAN_LEN <= 1) {
             ticks_count++;
-            data[head_idx++] = val;
-            if (head_idx == FILTER_LENGTH) head_idx = 0;
-            data_count++;
+            push_data(val);
             return;
         }
 
@@ -44,9 +50,7 @@ public:
 
         if (median_count >= MEDIAN_LEN)
         {
-            data[head_idx++] = median_filter.result();
-            if (head_idx == FILTER_LENGTH) head_idx = 0;
-            data_count++;
+            push_data(median_filter.result());
             median_count = 0;
             median_filter.reset();
         }
@@ -55,17 +59,8 @@ public:
     bool is_stable() {
         if (data_count < FILTER_LENGTH) return false;
 
-        fix16_t min = fix16_maximum;
-        fix16_t max = fix16_minimum;
-
-        // Temporary hardcoded for fixed length (3)
-        for (uint8_t i = 0; i < FILTER_LENGTH; i++)
-        {
-            fix16_t val = data[i];
-
-            if (val < min) min = val;
-            if (val > max) max = val;
-        }
+        fix16_t min = min_q.front();
+        fix16_t max = max_q.front();
 
         fix16_t diff = max - min;
 
@@ -85,21 +80,80 @@ public:
     }
 
     fix16_t average() {
-        fix16_t sum = 0;
+        return fix16_mul(sum, F16(1.0 / FILTER_LENGTH));
+    }
+
 
-        for (uint8_t i = 0; i < FILTER_LENGTH; i++)
+private:
+    // Sliding window min (or max, if MAX = true). Values, which can't become
+    // extremum before expire, are dropped on push.
+    template <bool MAX>
+    class MonotonicQueue {
+    public:
+        void reset()
         {
-            sum += data[i];
+            head = 0;
+            len = 0;
         }
 
-        return fix16_mul(sum, F16(1.0 / FILTER_LENGTH));
-    }
+        fix16_t front() { return val[head]; }
 
+        void push(fix16_t v, uint32_t v_seq)
+        {
+            // Drop expired
+            if (len && v_seq - seq[head] >= FILTER_LENGTH)
+            {
+                head = (head + 1 < FILTER_LENGTH) ? head + 1 : 0;
+                len--;
+            }
+
+            // Drop from tail values, dominated by new one
+            while (len)
+            {
+                int tail = head + len - 1;
+                if (tail >= FILTER_LENGTH) tail -= FILTER_LENGTH;
+
+                if (MAX ? val[tail] > v : val[tail] < v) break;
+                len--;
+            }
+
+            int idx = head + len;
+            if (idx >= FILTER_LENGTH) idx -= FILTER_LENGTH;
+
+            val[idx] = v;
+            seq[idx] = v_seq;
+            len++;
+        }
+
+    private:
+        fix16_t val[FILTER_LENGTH];
+        uint32_t seq[FILTER_LENGTH];
+        int head;
+        int len;
+    };
+
+    void push_data(fix16_t val)
+    {
+        sum += val - data[head_idx];
+        data[head_idx++] = val;
+        if (head_idx == FILTER_LENGTH) head_idx = 0;
+
+        min_q.push(val, seq);
+        max_q.push(val, seq);
+        seq++;
+
+        if (data_count < FILTER_LENGTH) data_count++;
+    }
 
-private:
     fix16_t data[FILTER_LENGTH];
     int head_idx;
     int data_count;
+    uint32_t seq;
+    fix16_t sum;
+
+    MonotonicQueue<false> min_q;
+    MonotonicQueue<true> max_q;
+
     int ticks_count;
     int median_count;
 
@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include "libfixmath/fix16.h"
+#include "fix16_instrument.h"
 
 // 1. Calculate σ (discrete random variable)
 // 2. Drop everything with deviation > 2σ and count mean for the rest.
@@ -8,7 +9,8 @@
 //
 // For efficiency, don't use root square (work with σ^2 instead)
 //
-// !!! count should NOT be > 16
+// !!! count should NOT be > 16. For 12-bit ADC data also count <= 11,
+//     to fit s^2 into int32 (found with FIX16_INSTRUMENT).
 //
 // src    - uint16 array
 // count  - number of elements
@@ -53,6 +55,9 @@ uint32_t truncated_mean(uint16_t *src, uint8_t count, fix16_t window)
 
     int mean = ((s + (count >> 1)) * inv_div[count]) >> 16;
 
+    // s^2 is passed to fix16_mul() as signed
+    FIX16_CHECK_RANGE((uint64_t)s * s, 0, INT32_MAX);
+
     // sigma_square = (s2 - (s * s / count)) / (count - 1);
     int sigma_square = fix16_mul(
         s2 - fix16_mul(s * s, inv_div[count]),
@@ -61,6 +66,7 @@ uint32_t truncated_mean(uint16_t *src, uint8_t count, fix16_t window)
 
     // quick & dirty multiply to win^2, when win is in fix16 format.
     // we suppose win is 1..2, and sigma^2 - 24 bits max
+    FIX16_CHECK_RANGE(sigma_square, 0, (1 << 24) - 1);
     int sigma_win_square = ((((window >> 8) * (window >> 8)) >> 12) * sigma_square) >> 4;
 
     // Drop big deviations and count mean for the rest
@@ -84,3 +90,5 @@ uint32_t truncated_mean(uint16_t *src, uint8_t count, fix16_t window)
 
     return ((s_mean_filtered + (s_mean_filtered_cnt >> 1)) * inv_div[s_mean_filtered_cnt]) >> 16;
 }
+
+#include "fix16_instrument_end.h"
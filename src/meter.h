@@ -4,15 +4,57 @@
 #include "math/fix16_math.h"
 #include "math/truncated_mean.h"
 #include "math/median.h"
+#include "math/fix16_recip.h"
+#include "math/fixed.h"
 #include "config_map.h"
 #include "app_hal.h"
 #include "app.h"
+// Should be the last
+#include "math/fix16_instrument.h"
+
+
+// Motor is considered stopped after 2 sec with closed triac.
+#define R_ADAPT_IDLE_TICKS (APP_TICK_FREQUENCY * 2)
+
+// Allowed range of R thermal drift. Bigger deviation means rotor was not
+// really stopped (back-EMF added to measured R), and result is dropped.
+#define R_ADAPT_FACTOR_MIN 0.8
+#define R_ADAPT_FACTOR_MAX 1.6
+
+// Speed (normalized) measured before first pulse should be ~ 0
+#define R_ADAPT_SPEED_MAX 0.01
+
+// Save R thermal factor to EEPROM not more often than once per 5 min,
+// and only if changed more than 1%.
+#define R_ADAPT_PERSIST_INTERVAL_TICKS (APP_TICK_FREQUENCY * 60 * 5)
+#define R_ADAPT_PERSIST_THRESHOLD 0.01
+
+// Max samples per mains period (>= 40Hz), for sums overflow check
+#define METER_PERIOD_TICKS_MAX (APP_TICK_FREQUENCY / 40)
+
+// Sliding median window for `speed_smoothed` (in periods of mains). Drops
+// single spikes, with latency of 2 periods (40ms at 50Hz).
+#define SPEED_MEDIAN_LENGTH 5
+
+
+// Instant values range: voltage < 1024v (`Io` scale gives up to ~724v),
+// current < 128A
+typedef Fixed<10, 16> meter_voltage_t;
+typedef Fixed<7, 16> meter_current_t;
+
+typedef decltype(meter_voltage_t() * meter_current_t()) meter_power_t;
+typedef decltype(meter_current_t() * meter_current_t()) meter_current2_t;
+
+// Noise thresholds (`cfg_min_*_sum_2e64`) are in Q32
+static_assert(meter_power_t::FRAC == 32 && meter_current2_t::FRAC == 32, "Sums should be Q32");
+static_assert((int)meter_voltage_t::INT >= (int)voltage_scale_t::INT, "Voltage range is less than Io scale");
 
 
 /*
     Meter. Process raw data to calculate virtual params:
 
-    - speed
+    - speed (raw & smoothed)
+    - motor resistance thermal drift
 */
 
 class Meter
@@ -20,7 +62,15 @@ class Meter
 public:
 
     fix16_t speed = 0;
+    // Speed with spikes removed by sliding median. Updated with `speed`.
+    fix16_t speed_smoothed = 0;
     bool is_r_calibrated = false;
+    // Cleared by calibrator while it drives motor, R table may be not
+    // actual, and pulses pattern differs from normal start.
+    bool r_adapt_enabled = true;
+
+    // Motor resistance change due heating, relative to calibrated R table.
+    fix16_t r_thermal_factor = fix16_one;
 
     // Config info
     fix16_t cfg_rekv_to_speed_factor;
@@ -54,20 +104,11 @@ public:
     // Load config from emulated EEPROM
     void configure()
     {
-        cfg_rekv_to_speed_factor = fix16_from_float(
-            eeprom_float_read(CFG_REKV_TO_SPEED_FACTOR_ADDR, CFG_REKV_TO_SPEED_FACTOR_DEFAULT)
-        );
-
-        #define R_CAL_CHECK_MARKER 123456789.0f
+        set_rekv_to_speed_factor(config.rekv_to_speed_factor);
 
         for (int i = 0; i < CFG_R_INTERP_TABLE_LENGTH; i++)
         {
-            cfg_r_table[i] = fix16_from_float(
-                eeprom_float_read(
-                    i + CFG_R_INTERP_TABLE_START_ADDR,
-                    R_CAL_CHECK_MARKER
-                )
-            );
+            cfg_r_table_calibrated[i] = config.r_interp_table[i];
         }
 
         // Pre-calclate inverted coeff-s to avoid divisions
@@ -75,7 +116,7 @@ public:
         cfg_r_table_setpoints_inerp_inv[0] = fix16_one;
         for (int i = 1; i < CFG_R_INTERP_TABLE_LENGTH; i++)
         {
-            if (cfg_r_table[i] - cfg_r_table[i - 1] > 0)
+            if (cfg_r_table_calibrated[i] - cfg_r_table_calibrated[i - 1] > 0)
             {
                 cfg_r_table_setpoints_inerp_inv[i] = fix16_div(
                     fix16_one,
@@ -85,24 +126,60 @@ public:
             else cfg_r_table_setpoints_inerp_inv[i] = fix16_one;
         }
 
-        is_r_calibrated = (cfg_r_table[0] == fix16_from_float(R_CAL_CHECK_MARKER)) ? false : true;
+        // Zero R (default) means table was not calibrated
+        is_r_calibrated = (cfg_r_table_calibrated[0] != 0);
+
+        r_thermal_factor = fix16_clamp(
+            config.r_thermal_factor,
+            F16(R_ADAPT_FACTOR_MIN),
+            F16(R_ADAPT_FACTOR_MAX)
+        );
+        r_thermal_factor_saved = r_thermal_factor;
+
+        r_table_apply_thermal_factor();
 
         reset_state();
     }
 
+    void set_rekv_to_speed_factor(fix16_t factor)
+    {
+        cfg_rekv_to_speed_factor = factor;
+        rekv_to_speed_factor_inv = fix16_recip_prepare(factor);
+    }
+
+    // Background task. Rate-limited save of R thermal factor, to survive
+    // restarts without flash wear. Returns `true` if EEPROM was written.
+    bool persist_tick()
+    {
+        if (r_adapt_persist_ticks < R_ADAPT_PERSIST_INTERVAL_TICKS) return false;
+
+        if (fix16_abs(r_thermal_factor - r_thermal_factor_saved) <
+            F16(R_ADAPT_PERSIST_THRESHOLD)) return false;
+
+        config_write(CFG_R_THERMAL_FACTOR, r_thermal_factor);
+
+        r_thermal_factor_saved = r_thermal_factor;
+        r_adapt_persist_ticks = 0;
+        return true;
+    }
+
     void reset_state()
     {
         speed = 0;
+        speed_smoothed = 0;
+        speed_median.reset();
 
-        p_sum_2e64 = 0;
-        i2_sum_2e64 = 0;
+        p_sum.reset();
+        i2_sum.reset();
         sum_counter = 0;
 
         io.out.clear();
     }
 
 private:
-    // Motor resistance interpolation table
+    // Motor resistance interpolation table, as measured by calibrator
+    fix16_t cfg_r_table_calibrated[CFG_R_INTERP_TABLE_LENGTH];
+    // The same, adjusted to current motor temperature
     fix16_t cfg_r_table[CFG_R_INTERP_TABLE_LENGTH];
     fix16_t cfg_r_interp_scale_inv_table[CFG_R_INTERP_TABLE_LENGTH];
 
@@ -131,10 +208,53 @@ private:
         return cfg_r_table[0];
     }
 
-    int64_t p_sum_2e64 = 0;  // active power << 32
-    int64_t i2_sum_2e64 = 0; // square of current << 32
+    // Cached reciprocal of `cfg_rekv_to_speed_factor`, to avoid division
+    fix16_recip_t rekv_to_speed_factor_inv = fix16_recip_prepare(F16(1));
+
+    // Active power & square of current, summed over mains period
+    FixedSum<meter_power_t, METER_PERIOD_TICKS_MAX> p_sum;
+    FixedSum<meter_current2_t, METER_PERIOD_TICKS_MAX> i2_sum;
     uint16_t sum_counter = 0;
 
+    SlidingMedianTemplate<fix16_t, SPEED_MEDIAN_LENGTH> speed_median;
+
+    // Continuous ticks with closed triac. Motor is stopped at power on.
+    uint32_t r_adapt_idle_ticks = R_ADAPT_IDLE_TICKS;
+    // Ticks since last R thermal factor save. Allow to save first result
+    // immediately.
+    uint32_t r_adapt_persist_ticks = R_ADAPT_PERSIST_INTERVAL_TICKS;
+    fix16_t r_thermal_factor_saved = fix16_one;
+
+    void r_table_apply_thermal_factor()
+    {
+        if (!is_r_calibrated) return;
+
+        for (int i = 0; i < CFG_R_INTERP_TABLE_LENGTH; i++)
+        {
+            cfg_r_table[i] = fix16_mul(cfg_r_table_calibrated[i], r_thermal_factor);
+        }
+    }
+
+    // Winding resistance rises with temperature. When motor starts from
+    // stopped state, back-EMF is zero, and measured R is pure motor
+    // resistance (the same as in static calibration). Use it to update
+    // thermal factor of R table.
+    void r_adapt(fix16_t r_measured, fix16_t setpoint)
+    {
+        fix16_t factor = fix16_mul(
+            r_thermal_factor,
+            fix16_div(r_measured, get_motor_resistance(setpoint))
+        );
+
+        // Out of range => rotor was spinning, drop result.
+        if (factor < F16(R_ADAPT_FACTOR_MIN) || factor > F16(R_ADAPT_FACTOR_MAX)) return;
+
+        // Single measure is noisy, smooth a bit.
+        r_thermal_factor = (r_thermal_factor + factor) >> 1;
+
+        r_table_apply_thermal_factor();
+    }
+
 
     void speed_tick(io_data_t &io_data)
     {
@@ -142,13 +262,36 @@ private:
         if (!is_r_calibrated)
         {
             speed = 0;
+            speed_smoothed = 0;
             return;
         }
 
-        // Calculate sums
-        // use 64 bits to prevent overflow (but sill keep dsired precision)
-        p_sum_2e64 += (int64_t)io_data.voltage * io_data.current;
-        i2_sum_2e64 += (uint64_t)io_data.current * io_data.current;
+        if (r_adapt_persist_ticks < R_ADAPT_PERSIST_INTERVAL_TICKS) r_adapt_persist_ticks++;
+
+        if (io.setpoint == 0)
+        {
+            if (r_adapt_idle_ticks < R_ADAPT_IDLE_TICKS) r_adapt_idle_ticks++;
+        }
+        // Short stop, rotor still spinning => count from zero again.
+        // When stop was long enough, wait for first pulse.
+        else if (r_adapt_idle_ticks < R_ADAPT_IDLE_TICKS) r_adapt_idle_ticks = 0;
+
+        // Zero cross lost (no mains or sensor failure). Drop sums, they
+        // can't hold more samples.
+        if (sum_counter >= METER_PERIOD_TICKS_MAX)
+        {
+            p_sum.reset();
+            i2_sum.reset();
+            sum_counter = 0;
+        }
+
+        // Calculate sums. Types guarantee no overflow (64 bits are really
+        // needed here).
+        meter_voltage_t voltage = meter_voltage_t::from_fix16(io_data.voltage);
+        meter_current_t current = meter_current_t::from_fix16(io_data.current);
+
+        p_sum.add(voltage * current);
+        i2_sum.add(current * current);
         sum_counter++;
 
         // Calculate speed at end of negative half-wave
@@ -161,15 +304,25 @@ private:
         {
             // 1. Filter noise.
             // 2. Avoid zero division.
-            if (p_sum_2e64 > cfg_min_p_sum_2e64 && i2_sum_2e64 > cfg_min_i2_sum_2e64)
+            if (p_sum.sum.raw > cfg_min_p_sum_2e64 && i2_sum.sum.raw > cfg_min_i2_sum_2e64)
             {
-                uint64_t p = p_sum_2e64, i2 = i2_sum_2e64;
-
-                NORMALIZE_TO_31_BIT(p, i2);
-
-                if (i2 > 0) {
-                    fix16_t r_ekv = fix16_div((fix16_t)p, (fix16_t)i2) - get_motor_resistance(io.setpoint);
-                    speed = fix16_div(r_ekv, cfg_rekv_to_speed_factor);
+                fix16_t r_total = fix16_ratio64((uint64_t)p_sum.sum.raw, (uint64_t)i2_sum.sum.raw);
+
+                // fix16_minimum => I^2 lost after normalization (zero division)
+                if (r_total != fix16_minimum) {
+
+                    // First pulse after stop => update R thermal drift.
+                    if (r_adapt_enabled &&
+                        r_adapt_idle_ticks >= R_ADAPT_IDLE_TICKS &&
+                        io.setpoint > 0 &&
+                        speed_smoothed < F16(R_ADAPT_SPEED_MAX))
+                    {
+                        r_adapt(r_total, io.setpoint);
+                        r_adapt_idle_ticks = 0;
+                    }
+
+                    fix16_t r_ekv = fix16_sub(r_total, get_motor_resistance(io.setpoint));
+                    speed = fix16_mul_recip(r_ekv, rekv_to_speed_factor_inv);
                 }
                 else speed = 0;
 
@@ -178,12 +331,17 @@ private:
             }
             else speed = 0;
 
-            p_sum_2e64 = 0;
-            i2_sum_2e64 = 0;
+            speed_median.add(speed);
+            speed_smoothed = speed_median.result();
+
+            p_sum.reset();
+            i2_sum.reset();
             sum_counter = 0;
         }
     }
 };
 
+#include "math/fix16_instrument_end.h"
+
 
 #endif
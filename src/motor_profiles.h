@@ -0,0 +1,44 @@
+#ifndef __MOTOR_PROFILES__
+#define __MOTOR_PROFILES__
+
+// Pre-characterized motors. Used to skip static calibration at first boot,
+// when unit has known motor. Profile is selected by quick R probe (see
+// `calibrator/calibrator_profile_match.h`).
+//
+// Only R table is stored. Speed factor & ADRC coefficients depend on
+// mechanics (gear, load) and are not measured for shipped profiles. So
+// matched unit is not considered calibrated: motor runs at slow fixed
+// power until full calibration is done (see `CFG_ADRC_PENDING`).
+//
+// To add new profile, calibrate reference unit and copy R table from it's
+// EEPROM.
+
+#include "math/fix16_math.h"
+#include "config_map.h"
+
+
+struct motor_profile_t {
+    // Motor resistance at `Meter::cfg_r_table_setpoints`
+    fix16_t r_table[CFG_R_INTERP_TABLE_LENGTH];
+};
+
+
+static const motor_profile_t motor_profiles[] = {
+    // Reference motor from `doc/data/r_calibration.ods`.
+    {
+        {
+            F16(169.288162),
+            F16(123.165817),
+            F16(106.433914),
+            F16(92.388702),
+            F16(89.266174),
+            F16(89.906204),
+            F16(89.906204)
+        }
+    }
+};
+
+constexpr int motor_profiles_count = sizeof(motor_profiles) / sizeof(motor_profiles[0]);
+
+
+#endif
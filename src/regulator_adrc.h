@@ -5,6 +5,10 @@
 #include "app.h"
 #include "config_map.h"
 #include "math/fix16_math.h"
+#include "math/fixed.h"
+#include "math/knob_curve.h"
+// Should be the last
+#include "math/fix16_instrument.h"
 
 // ADRC iteration frequency, Hz. To fit math in fix16 without overflow.
 // Observers in ADRC system must have performance much higher
@@ -16,8 +20,26 @@
 #define ADRC_BO 5.0f
 
 constexpr int freq_divisor = APP_TICK_FREQUENCY / APP_ADRC_FREQUENCY;
-// Coefficient used by ADRC observers integrators
-constexpr fix16_t integr_coeff = F16(1.0 / APP_ADRC_FREQUENCY);
+
+// Coefficient used by ADRC observers integrators. Has only 6 significant
+// bits in fix16, so more precise format used (1/1000 => 131, -0.05%).
+typedef Fixed<0, 17> integr_coeff_t;
+constexpr integr_coeff_t integr_coeff = integr_coeff_t::from_double(1.0 / APP_ADRC_FREQUENCY);
+
+// Integrators input (rate of normalized speed change, 1/s). Clamped to
+// +/-128, far beyond motor dynamics (T ~ 0.2s, speed ~ 1). Fractional bits
+// below 2^-7 are lost anyway after multiply by 1/1000.
+typedef Fixed<7, 7> integr_in_t;
+constexpr fix16_t integr_in_max = integr_in_t::from_raw((1 << 14) - 1).to_fix16();
+
+static_assert(sizeof((integr_in_t() * integr_coeff_t()).raw) == 4, "64-bit multiply in integrator");
+
+// Normalized RPM limits are < 60 (config schema)
+typedef Fixed<6, 16> rpm_norm_t;
+typedef Fixed<3, 4> adrc_b0_t;
+constexpr adrc_b0_t adrc_b0 = adrc_b0_t::from_double(ADRC_BO);
+
+static_assert(sizeof((rpm_norm_t() * adrc_b0_t()).raw) == 4, "64-bit multiply in anti-windup");
 
 class Regulator
 {
@@ -51,7 +73,7 @@ public:
 
         tick_freq_divide_counter++;
 
-        knob_normalized = normalize_knob(knob);
+        knob_normalized = knob_curve.map(knob);
 
         regulator_speed_out = speed_adrc_tick(speed);
         out_power = regulator_speed_out;
@@ -60,34 +82,39 @@ public:
     // Load config from emulated EEPROM
     void configure()
     {
-        cfg_dead_zone_width_norm = fix16_from_float(eeprom_float_read(CFG_DEAD_ZONE_WIDTH_ADDR,
-            CFG_DEAD_ZONE_WIDTH_DEFAULT) / 100.0f);
+        cfg_dead_zone_width_norm = config.dead_zone_width / 100;
 
-        float _rpm_max = eeprom_float_read(CFG_RPM_MAX_ADDR, CFG_RPM_MAX_DEFAULT);
+        uint32_t _rpm_max = config.rpm_max;
 
-        cfg_rpm_max_limit_norm = fix16_from_float(
-            eeprom_float_read(CFG_RPM_MAX_LIMIT_ADDR, CFG_RPM_MAX_LIMIT_DEFAULT) / _rpm_max
-        );
+        // RPM values are < 65536 (checked by config schema), shift is safe
+        cfg_rpm_max_limit_norm = (fix16_t)((config.rpm_max_limit << 16) / _rpm_max);
 
-        float _rpm_min_limit = eeprom_float_read(CFG_RPM_MIN_LIMIT_ADDR, CFG_RPM_MIN_LIMIT_DEFAULT);
+        uint32_t _rpm_min_limit = config.rpm_min_limit;
         // Don't allow too small low limit
         // ~ 3000 for 35000 max limit
-        if (_rpm_min_limit < _rpm_max * 0.085f) _rpm_min_limit = _rpm_max * 0.085f;
+        if (_rpm_min_limit < _rpm_max * 85 / 1000) _rpm_min_limit = _rpm_max * 85 / 1000;
 
-        cfg_rpm_min_limit_norm = fix16_from_float(_rpm_min_limit / _rpm_max);
+        cfg_rpm_min_limit_norm = (fix16_t)((_rpm_min_limit << 16) / _rpm_max);
 
-        knob_norm_coeff =  fix16_div(
-            cfg_rpm_max_limit_norm - cfg_rpm_min_limit_norm,
-            fix16_one - cfg_dead_zone_width_norm
-        );
+        fix16_t knob_curve_points[KNOB_CURVE_POINTS_COUNT];
+
+        for (int i = 0; i < KNOB_CURVE_POINTS_COUNT; i++)
+        {
+            knob_curve_points[i] = config.knob_curve_points[i] / 100;
+        }
 
-        cfg_adrc_Kp = fix16_from_float(eeprom_float_read(CFG_ADRC_KP_ADDR,
-            CFG_ADRC_KP_DEFAULT));
-        cfg_adrc_Kobservers = fix16_from_float(eeprom_float_read(CFG_ADRC_KOBSERVERS_ADDR,
-            CFG_ADRC_KOBSERVERS_DEFAULT));
+        knob_curve.configure(
+            (knob_curve_type_t)config.knob_curve,
+            cfg_dead_zone_width_norm,
+            config.knob_hysteresis / 100,
+            cfg_rpm_min_limit_norm,
+            cfg_rpm_max_limit_norm,
+            knob_curve_points
+        );
 
-        cfg_adrc_p_corr_coeff = fix16_from_float(eeprom_float_read(CFG_ADRC_P_CORR_COEFF_ADDR,
-                                                             CFG_ADRC_P_CORR_COEFF_DEFAULT));
+        cfg_adrc_Kp = config.adrc_kp;
+        cfg_adrc_Kobservers = config.adrc_kobservers;
+        cfg_adrc_p_corr_coeff = config.adrc_p_corr_coeff;
 
         adrc_b0_inv = F16(1.0f / ADRC_BO);
 
@@ -111,6 +138,7 @@ public:
         adrc_correction = 0;
 
         regulator_speed_out = 0;
+        knob_curve.reset();
         // Skip iteration to allow meter resync
         tick_freq_divide_counter = 1;
     }
@@ -123,8 +151,8 @@ private:
     fix16_t cfg_rpm_max_limit_norm;
     fix16_t cfg_rpm_min_limit_norm;
 
-    // Cache for knob normalization, calculated on config load
-    fix16_t knob_norm_coeff = F16(1);
+    // Knob => speed transfer curve, built on config load
+    KnobCurve knob_curve;
     // knob value normalized to range (cfg_rpm_min_limit..cfg_rpm_max_limit)
     fix16_t knob_normalized;
 
@@ -138,15 +166,18 @@ private:
 
     uint32_t tick_freq_divide_counter = 0;
 
-    // Apply min/max limits to knob output
-    fix16_t normalize_knob(fix16_t knob)
+    // Q7.7 * Q0.17 product fits 32 bits, single hardware multiply on M0
+    static fix16_t integrate(fix16_t val)
     {
-        if (knob < cfg_dead_zone_width_norm) return 0;
+        fix16_t v = fix16_clamp(val, -integr_in_max, integr_in_max);
 
-        return fix16_mul(
-            (knob - cfg_dead_zone_width_norm),
-            knob_norm_coeff
-        ) + cfg_rpm_min_limit_norm;
+        return (integr_in_t::from_fix16(v) * integr_coeff).to_fix16();
+    }
+
+    // b0 * limit, no division
+    static fix16_t mul_b0(fix16_t limit_norm)
+    {
+        return (rpm_norm_t::from_fix16(limit_norm) * adrc_b0).to_fix16();
     }
 
     fix16_t speed_adrc_tick(fix16_t speed)
@@ -156,16 +187,17 @@ private:
         // Proportional correction signal,
         // makes reaction to motor load change
         // significantly faster
-        fix16_t adrc_p_correction = fix16_mul((speed - adrc_speed_estimated), cfg_adrc_p_corr_coeff);
+        fix16_t speed_error = fix16_sub(speed, adrc_speed_estimated);
+        fix16_t adrc_p_correction = fix16_mul(speed_error, cfg_adrc_p_corr_coeff);
         
         // u0 - output of linear proportional controller in ADRC system
-        fix16_t u0 = fix16_mul((knob_normalized - adrc_speed_estimated), cfg_adrc_Kp);
+        fix16_t u0 = fix16_mul(fix16_sub(knob_normalized, adrc_speed_estimated), cfg_adrc_Kp);
         // 2 state observers:
         //   - speed observer (adrc_speed_estimated)
         //   - generalized disturbance observer (adrc_correction)
-        adrc_correction += fix16_mul(fix16_mul(speed - adrc_speed_estimated, adrc_L2), integr_coeff);
-        adrc_speed_estimated += fix16_mul(u0 + fix16_mul(adrc_L1, (speed - adrc_speed_estimated)),
-         integr_coeff);
+        adrc_correction = fix16_add(adrc_correction, integrate(fix16_mul(speed_error, adrc_L2)));
+        adrc_speed_estimated = fix16_add(adrc_speed_estimated,
+            integrate(fix16_add(u0, fix16_mul(adrc_L1, speed_error))));
 
         adrc_speed_estimated = fix16_clamp(
             adrc_speed_estimated,
@@ -173,7 +205,7 @@ private:
             cfg_rpm_max_limit_norm
         );
 
-        fix16_t output = fix16_mul((u0 - adrc_correction - adrc_p_correction), adrc_b0_inv);
+        fix16_t output = fix16_mul(fix16_sub(fix16_sub(u0, adrc_correction), adrc_p_correction), adrc_b0_inv);
 
         // Anti-Windup
         // 0 <= output <= 1
@@ -183,7 +215,7 @@ private:
         if (output < cfg_rpm_min_limit_norm)
         {
             output = cfg_rpm_min_limit_norm;
-            adrc_correction = u0 - fix16_div(cfg_rpm_min_limit_norm, adrc_b0_inv);
+            adrc_correction = fix16_sub(u0, mul_b0(cfg_rpm_min_limit_norm));
         }
 
         // output = (u0 - adrc_correction)/b0,
@@ -191,12 +223,14 @@ private:
         if (output > cfg_rpm_max_limit_norm)
         {
             output = cfg_rpm_max_limit_norm;
-            adrc_correction = u0 - fix16_div(cfg_rpm_max_limit_norm, adrc_b0_inv);
+            adrc_correction = fix16_sub(u0, mul_b0(cfg_rpm_max_limit_norm));
         }
 
         return output;
     }
 };
 
+#include "math/fix16_instrument_end.h"
+
 
 #endif
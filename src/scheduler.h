@@ -0,0 +1,93 @@
+#ifndef __SCHEDULER__
+#define __SCHEDULER__
+
+// Cooperative scheduler for background work in main loop.
+//
+// Control processing (meter, calibrator, regulator) runs first on each new
+// ADC tick, directly from main loop. Background tasks (EEPROM flush,
+// telemetry, diagnostics) run only in idle slack, while main loop waits for
+// next ADC data.
+//
+// - Tasks run by priority (lower value first).
+// - Each task has budget - max calls per ADC tick. Task should do short
+//   piece of work per call (usually single YIELD step).
+// - Task returns `false` when has nothing to do. Then it's not called until
+//   next ADC tick.
+//
+// `idle_count` counts wait loops when no task had work. Use it to estimate
+// free CPU time.
+
+#include <stdint.h>
+
+
+typedef bool (*scheduler_task_fn_t)();
+
+
+template <uint8_t MAX_TASKS>
+class Scheduler
+{
+public:
+    uint32_t idle_count = 0;
+
+    // Returns `false` if no free slots
+    bool add(scheduler_task_fn_t fn, uint8_t priority, uint8_t budget)
+    {
+        if (tasks_count >= MAX_TASKS) return false;
+
+        // Keep list sorted by priority. Tasks with the same priority run
+        // in order of addition.
+        uint8_t i = tasks_count;
+
+        while (i > 0 && tasks[i - 1].priority > priority)
+        {
+            tasks[i] = tasks[i - 1];
+            i--;
+        }
+
+        tasks[i].fn = fn;
+        tasks[i].priority = priority;
+        tasks[i].budget = budget;
+        tasks_count++;
+
+        return true;
+    }
+
+    // Run background tasks until `ready()` returns `true` (new data
+    // available for control processing).
+    template <typename READY>
+    void wait(READY ready)
+    {
+        for (uint8_t i = 0; i < tasks_count; i++) budget_left[i] = tasks[i].budget;
+
+        while (!ready())
+        {
+            uint8_t i = 0;
+
+            while (i < tasks_count && budget_left[i] == 0) i++;
+
+            if (i == tasks_count)
+            {
+                idle_count++;
+                continue;
+            }
+
+            budget_left[i]--;
+
+            if (!tasks[i].fn()) budget_left[i] = 0;
+        }
+    }
+
+private:
+    struct task_t {
+        scheduler_task_fn_t fn;
+        uint8_t priority;
+        uint8_t budget;
+    };
+
+    task_t tasks[MAX_TASKS];
+    uint8_t budget_left[MAX_TASKS];
+    uint8_t tasks_count = 0;
+};
+
+
+#endif
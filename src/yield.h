@@ -4,17 +4,31 @@
 #include <stdbool.h>
 #include <setjmp.h>
 
+// Two ways to keep resume state:
+//
+// - YIELDABLE - in function's static variable. Only one FSM instance can
+//   exist, state can not be reset from outside.
+// - YIELDABLE_WITH(frame) - in user-provided `yield_frame_t` variable
+//   (usually class member). Every object has independent FSM, and
+//   `frame.reset()` restarts it from the beginning.
+
 #ifdef YIELD_USE_JMP
 
 struct _yield_state_t {
     jmp_buf env;
-    bool yielded;
+    bool yielded = false;
+
+    void reset() { yielded = false; }
 };
 
 #define YIELDABLE \
     static struct _yield_state_t _yield_state; \
     if (_yield_state.yielded) longjmp(_yield_state.env, 1); \
 
+#define YIELDABLE_WITH(frame) \
+    struct _yield_state_t &_yield_state = (frame); \
+    if (_yield_state.yielded) longjmp(_yield_state.env, 1); \
+
 #define YIELD(val) \
     do { \
         if (!setjmp(_yield_state.env)) { _yield_state.yielded = true; return val; } \
@@ -24,8 +38,10 @@ struct _yield_state_t {
 #else
 
 struct _yield_state_t {
-    void *yield_ptr;
-    bool yielded;
+    void *yield_ptr = nullptr;
+    bool yielded = false;
+
+    void reset() { yielded = false; }
 };
 
 #define _yield_label3(prefix, line) prefix ## line
@@ -36,6 +52,10 @@ struct _yield_state_t {
     static struct _yield_state_t _yield_state; \
     if (_yield_state.yielded) goto *_yield_state.yield_ptr; \
 
+#define YIELDABLE_WITH(frame) \
+    struct _yield_state_t &_yield_state = (frame); \
+    if (_yield_state.yielded) goto *_yield_state.yield_ptr; \
+
 #define YIELD(val) \
     do { \
         _yield_state.yield_ptr = &&_yield_label; \
@@ -47,6 +67,8 @@ struct _yield_state_t {
 
 #endif
 
+typedef struct _yield_state_t yield_frame_t;
+
 // Helpers
 
 #define YIELD_WHILE(cond, val) while (cond) { YIELD(val); }
@@ -0,0 +1,143 @@
+#ifndef __YIELD_CORO_H__
+#define __YIELD_CORO_H__
+
+// Optional FSM backend on C++20 stackless coroutines. Alternative to YIELD
+// macros, with the same `bool tick()` contract. Unlike macros, locals survive
+// suspension.
+//
+// Requires GCC 10+ (`-std=gnu++2a -fcoroutines`, GCC 11+ needs `-std=gnu++20`
+// only). Enable with `-D YIELD_USE_COROUTINES`.
+//
+// No heap use. Coroutine must be non-static member function of owner class,
+// and frame is placed into owner's `coro_frame` buffer. Frame size is known
+// to compiler only, so buffer size is selected manually. If buffer is too
+// small, start of coroutine traps (HardFault on MCU), instead of silently
+// broken FSM. Use `yield_coro_t::last_frame_size` on host to pick proper
+// value, and keep a host test, running each coroutine at least once.
+//
+// Cost of `CalibratorWaitKnobDial` (GCC 12, -Os, x86-64 host), vs YIELD macros:
+//
+// - code: 628 bytes vs 224 (frame setup/destroy + resume dispatch),
+// - RAM: 80 bytes vs 24 (frame buffer, frame is 64 bytes on host).
+//
+// On Cortex-M pointers are 2x smaller, so frame is smaller too. ARM numbers
+// are not measured yet. Check with `arm-none-eabi-size` before enabling on
+// F042 (6K RAM, 32K flash).
+//
+// Only `CalibratorWaitKnobDial` has coroutine variant. Noise, profile match,
+// static & ADRC calibrators stay on YIELD macros in both modes. Their frames
+// would hold all locals of long FSMs, and should be sized & measured on
+// target first.
+//
+// Usage:
+//
+//   class Fsm {
+//   public:
+//       bool tick() {
+//           if (!coro.active()) coro = run();
+//           return coro.resume();
+//       }
+//   private:
+//       friend struct yield_coro_t::promise_type;
+//       yield_coro_frame_t<64> coro_frame;
+//       yield_coro_t coro;
+//
+//       yield_coro_t run() {
+//           for (int i = 0; i < 3; i++) co_yield false;
+//           co_return true;
+//       }
+//   };
+
+#include <stddef.h>
+#include <stdint.h>
+#include <coroutine>
+
+
+template <size_t SIZE>
+struct yield_coro_frame_t {
+    alignas(8) uint8_t data[SIZE];
+};
+
+
+class yield_coro_t
+{
+public:
+    struct promise_type {
+        bool value = false;
+
+        template <typename OWNER, typename... ARGS>
+        // Never returns nullptr, so no `noexcept` (that would require
+        // `get_return_object_on_allocation_failure()`)
+        static void *operator new(size_t size, OWNER &owner, ARGS&...)
+        {
+            last_frame_size = size;
+            if (size > sizeof(owner.coro_frame.data)) __builtin_trap();
+            return owner.coro_frame.data;
+        }
+
+        static void operator delete(void *) noexcept {}
+
+        yield_coro_t get_return_object() noexcept
+        {
+            return yield_coro_t(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+
+        std::suspend_always yield_value(bool val) noexcept { value = val; return {}; }
+        void return_value(bool val) noexcept { value = val; }
+
+        void unhandled_exception() noexcept {}
+    };
+
+    // Frame size requested by last started coroutine
+    static inline size_t last_frame_size = 0;
+
+    yield_coro_t() {}
+
+    yield_coro_t(yield_coro_t &&other) noexcept : handle(other.handle) { other.handle = nullptr; }
+
+    yield_coro_t &operator=(yield_coro_t &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            handle = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+
+    ~yield_coro_t() { reset(); }
+
+    bool active() { return (bool)handle; }
+
+    // Run until next `co_yield` or `co_return`, and return it's value.
+    // Finished coroutine is destroyed, next `tick()` should start new one.
+    bool resume()
+    {
+        if (!handle) return false;
+
+        handle.resume();
+        bool val = handle.promise().value;
+
+        if (handle.done()) reset();
+
+        return val;
+    }
+
+    void reset()
+    {
+        if (handle) handle.destroy();
+        handle = nullptr;
+    }
+
+private:
+    explicit yield_coro_t(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+    std::coroutine_handle<promise_type> handle = nullptr;
+};
+
+
+#endif
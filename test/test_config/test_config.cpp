@@ -0,0 +1,160 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include "../src/config_map.h"
+
+// Minimal EEPROM with raw values by address
+struct FakeEeprom {
+    uint32_t data[CFG_ADDR_SPACE];
+    bool exists[CFG_ADDR_SPACE] = {};
+    uint32_t reads = 0;
+
+    uint32_t read_u32(uint32_t addr, uint32_t dflt)
+    {
+        reads++;
+        return exists[addr] ? data[addr] : dflt;
+    }
+
+    void write_u32(uint32_t addr, uint32_t val)
+    {
+        data[addr] = val;
+        exists[addr] = true;
+    }
+
+    void write_float(uint32_t addr, float val)
+    {
+        union { uint32_t i; float f; } x;
+        x.f = val;
+        write_u32(addr, x.i);
+    }
+
+    void begin() {}
+    void commit() {}
+    void flush() {}
+};
+
+
+void test_config_defaults() {
+    FakeEeprom eeprom;
+    config_t cfg;
+
+    cfg_load(eeprom, cfg);
+
+    TEST_ASSERT_EQUAL(CFG_COUNT, eeprom.reads);
+    TEST_ASSERT_EQUAL_INT32(F16(10.0), cfg.shunt_resistance);
+    TEST_ASSERT_EQUAL_UINT32(37500, cfg.rpm_max);
+    TEST_ASSERT_EQUAL_UINT32(5000, cfg.rpm_min_limit);
+    TEST_ASSERT_EQUAL_UINT32(30000, cfg.rpm_max_limit);
+    TEST_ASSERT_EQUAL_INT32(F16(450.0), cfg.rekv_to_speed_factor);
+    TEST_ASSERT_EQUAL_INT32(0, cfg.r_interp_table[0]);
+    TEST_ASSERT_EQUAL_INT32(fix16_one, cfg.r_thermal_factor);
+    TEST_ASSERT_EQUAL_UINT32(KNOB_CURVE_LINEAR, cfg.knob_curve);
+    TEST_ASSERT_EQUAL_INT32(F16(100.0), cfg.knob_curve_points[KNOB_CURVE_POINTS_COUNT - 1]);
+    // Absent on calibrated units of old firmware => not pending
+    TEST_ASSERT_EQUAL_UINT32(0, cfg.adrc_pending);
+}
+
+void test_config_stored_values() {
+    FakeEeprom eeprom;
+    config_t cfg;
+
+    eeprom.write_u32(cfg_schema[CFG_ADRC_KP].addr, (uint32_t)F16(3.5));
+    eeprom.write_u32(cfg_schema[CFG_RPM_MAX].addr, 40000);
+    eeprom.write_u32(cfg_schema[CFG_R_INTERP_TABLE_START + 6].addr, (uint32_t)F16(89.9));
+
+    cfg_load(eeprom, cfg);
+
+    TEST_ASSERT_EQUAL_INT32(F16(3.5), cfg.adrc_kp);
+    TEST_ASSERT_EQUAL_UINT32(40000, cfg.rpm_max);
+    TEST_ASSERT_EQUAL_INT32(F16(89.9), cfg.r_interp_table[6]);
+}
+
+void test_config_out_of_range() {
+    FakeEeprom eeprom;
+    config_t cfg;
+
+    // Negative fix16 & too big integer should fall back to defaults
+    eeprom.write_u32(cfg_schema[CFG_ADRC_KOBSERVERS].addr, (uint32_t)F16(-1.0));
+    eeprom.write_u32(cfg_schema[CFG_RPM_MAX_LIMIT].addr, 100000);
+    eeprom.write_u32(cfg_schema[CFG_R_THERMAL_FACTOR].addr, (uint32_t)F16(5.0));
+
+    cfg_load(eeprom, cfg);
+
+    TEST_ASSERT_EQUAL_INT32(F16(1.0), cfg.adrc_kobservers);
+    TEST_ASSERT_EQUAL_UINT32(30000, cfg.rpm_max_limit);
+    TEST_ASSERT_EQUAL_INT32(F16(1.0), cfg.r_thermal_factor);
+}
+
+void test_config_clamp() {
+    const cfg_entry_t &e = cfg_schema[CFG_R_THERMAL_FACTOR];
+
+    TEST_ASSERT_EQUAL_INT32(F16(2.0), (int32_t)cfg_clamp(e, (uint32_t)F16(3.0)));
+    TEST_ASSERT_EQUAL_INT32(F16(0.5), (int32_t)cfg_clamp(e, (uint32_t)F16(-3.0)));
+    TEST_ASSERT_EQUAL_INT32(F16(1.2), (int32_t)cfg_clamp(e, (uint32_t)F16(1.2)));
+}
+
+void test_config_migrate_from_float() {
+    FakeEeprom eeprom;
+    config_t cfg;
+
+    // Old firmware data
+    eeprom.write_float(cfg_schema[CFG_RPM_MAX].addr, 40000.0f);
+    eeprom.write_float(cfg_schema[CFG_ADRC_KP].addr, 3.5f);
+    eeprom.write_float(cfg_schema[CFG_R_INTERP_TABLE_START].addr, 169.288162f);
+    // Old "not calibrated" marker
+    eeprom.write_float(cfg_schema[CFG_R_INTERP_TABLE_START + 1].addr, 123456789.0f);
+
+    cfg_migrate(eeprom);
+    cfg_load(eeprom, cfg);
+
+    TEST_ASSERT_EQUAL_UINT32(CFG_FORMAT_NATIVE, eeprom.data[CFG_FORMAT_ADDR]);
+    TEST_ASSERT_EQUAL_UINT32(40000, cfg.rpm_max);
+    TEST_ASSERT_EQUAL_INT32(F16(3.5), cfg.adrc_kp);
+    TEST_ASSERT_INT32_WITHIN(2, F16(169.288162), cfg.r_interp_table[0]);
+    TEST_ASSERT_EQUAL_INT32(0, cfg.r_interp_table[1]);
+    // Absent values are not written
+    TEST_ASSERT_FALSE(eeprom.exists[cfg_schema[CFG_SHUNT_RESISTANCE].addr]);
+    TEST_ASSERT_EQUAL_INT32(F16(10.0), cfg.shunt_resistance);
+
+    // Second run does nothing
+    cfg_migrate(eeprom);
+    cfg_load(eeprom, cfg);
+
+    TEST_ASSERT_EQUAL_INT32(F16(3.5), cfg.adrc_kp);
+}
+
+void test_config_migrate_resume() {
+    FakeEeprom eeprom;
+    config_t cfg;
+
+    // Power lost after first group: it's converted, the rest is float
+    eeprom.write_u32(cfg_schema[CFG_ADRC_KP].addr, (uint32_t)F16(3.5));
+    eeprom.write_float(cfg_schema[CFG_R_THERMAL_FACTOR].addr, 1.25f);
+    eeprom.write_u32(CFG_FORMAT_ADDR, CFG_FORMAT_MIGRATING | CFG_MIGRATE_GROUP_SIZE);
+
+    cfg_migrate(eeprom);
+    cfg_load(eeprom, cfg);
+
+    TEST_ASSERT_EQUAL_UINT32(CFG_FORMAT_NATIVE, eeprom.data[CFG_FORMAT_ADDR]);
+    TEST_ASSERT_EQUAL_INT32(F16(3.5), cfg.adrc_kp);
+    TEST_ASSERT_EQUAL_INT32(F16(1.25), cfg.r_thermal_factor);
+}
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_config_defaults);
+    RUN_TEST(test_config_stored_values);
+    RUN_TEST(test_config_out_of_range);
+    RUN_TEST(test_config_clamp);
+    RUN_TEST(test_config_migrate_from_float);
+    RUN_TEST(test_config_migrate_resume);
+    return UNITY_END();
+}
+
+#endif
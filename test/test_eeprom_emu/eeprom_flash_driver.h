@@ -5,27 +5,67 @@
 
 #include <stdint.h>
 
-class EepromFlashDriver
+#include "eeprom_emu.h"
+
+template <uint8_t BANK_COUNT, uint8_t PROGRAM_WIDTH = 2, uint8_t LOCK_SCOPE = EEPROM_LOCK_PER_OP,
+          uint32_t ERASE_SIZE = EEPROM_EMU_BANK_SIZE>
+class EepromFlashDriverBanks
 {
 public:
-    EepromFlashDriver()
+    EepromFlashDriverBanks()
     {
-        for (uint32_t i = 0; i < BankSize*2; i++) memory[i] = 0xFF;
+        for (uint32_t i = 0; i < BankSize*BankCount; i++) memory[i] = 0xFF;
     }
 
     static const uint32_t BankSize = EEPROM_EMU_BANK_SIZE;
+    static const uint8_t BankCount = BANK_COUNT;
+    static const uint8_t ProgramWidth = PROGRAM_WIDTH;
+    static const uint32_t EraseSize = ERASE_SIZE;
+    static const uint8_t LockScope = LOCK_SCOPE;
+
+    uint8_t memory[BankSize*BankCount];
+
+    // Statistics, for benchmarks
+    uint32_t reads = 0;
+    uint32_t writes = 0;
+    // Page erases
+    uint32_t erases = 0;
+    // Full bank erase cycles (counted at first page)
+    uint32_t bank_erases[BankCount] = {};
+    uint32_t unlocks = 0;
+    // Contract violations: program/erase while locked, double-word
+    // re-programming, half-word program on wide flash.
+    uint32_t violations = 0;
+
+    bool unlocked = false;
+
+    void unlock()
+    {
+        if (unlocked) violations++;
+        unlocked = true;
+        unlocks++;
+    }
 
-    uint8_t memory[BankSize*2];
+    void lock()
+    {
+        if (!unlocked) violations++;
+        unlocked = false;
+    }
 
-    void erase(uint8_t bank)
+    void erase(uint8_t bank, uint32_t addr)
     {
-        for (uint32_t i = 0; i < BankSize; i++) memory[bank*BankSize + i] = 0xFF;
+        check_unlocked();
+        if (addr % EraseSize) violations++;
+        erases++;
+        if (addr == 0) bank_erases[bank]++;
+        for (uint32_t i = 0; i < EraseSize; i++) memory[bank*BankSize + addr + i] = 0xFF;
     }
 
     uint16_t read_u16(uint8_t bank, uint32_t addr)
     {
         uint32_t ofs = bank*BankSize + addr;
 
+        reads++;
         return uint16_t(memory[ofs] + (memory[ofs+1] << 8));
     }
 
@@ -33,9 +73,36 @@ public:
     {
         uint32_t ofs = bank*BankSize + addr;
 
+        check_unlocked();
+        if (ProgramWidth != 2) violations++;
+        writes++;
         memory[ofs] = (uint8_t)data & 0xFF;
         memory[ofs+1] = (uint8_t)(data >> 8) & 0xFF;
     }
+
+    void write_u64(uint8_t bank, uint32_t addr, uint64_t data)
+    {
+        uint32_t ofs = bank*BankSize + addr;
+
+        check_unlocked();
+        if (ProgramWidth != 8 || (addr & 7)) violations++;
+
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            if (memory[ofs + i] != 0xFF) violations++;
+        }
+
+        writes++;
+        for (uint32_t i = 0; i < 8; i++) memory[ofs + i] = (uint8_t)(data >> (i * 8)) & 0xFF;
+    }
+
+private:
+    void check_unlocked()
+    {
+        if (LockScope != EEPROM_LOCK_PER_OP && !unlocked) violations++;
+    }
 };
 
+typedef EepromFlashDriverBanks<2> EepromFlashDriver;
+
 #endif
@@ -8,6 +8,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <chrono>
 
 /*void mem_dump(EepromEmu<EepromFlashDriver> &eeprom)
 {
@@ -169,6 +170,780 @@ void test_eeprom_float() {
     TEST_ASSERT_EQUAL_HEX32(0.44F, eeprom.read_float(3, 0.0F));
 }
 
+void test_eeprom_group_write() {
+    EepromEmu<EepromFlashDriver, 0x4499> eeprom;
+
+    eeprom.write_u32(3, 0x0000AA99);
+
+    eeprom.begin();
+    eeprom.write_u32(3, 0x0000AA99); // Same value, should be skipped
+    eeprom.write_u32(4, 0x11112222);
+    eeprom.write_u32(5, 0x33334444);
+
+    // Pending values are readable, but not in flash yet
+    TEST_ASSERT_EQUAL_HEX32(0x11112222, eeprom.read_u32(4, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, eeprom.flash.memory[16]);
+
+    eeprom.commit();
+
+    uint8_t expected[] = {
+        0xEE, 0x77, 0xFF, 0xFF, 0x99, 0x44, 0xFF, 0xFF, // Bank header
+        0xAA, 0x55,                 // commit mark
+        0x03, 0x00,                 // addr
+        0x99, 0xAA, 0x00, 0x00,     // data
+        0xFF, 0xFF,                 // group member, no commit mark
+        0x04, 0x00,                 // addr
+        0x22, 0x22, 0x11, 0x11,     // data
+        0xFF, 0xFF,                 // group member, no commit mark
+        0x05, 0x00,                 // addr
+        0x44, 0x44, 0x33, 0x33,     // data
+        0xCC, 0x33,                 // group commit mark
+        0x02, 0x00,                 // count
+        0xFD, 0xFF,                 // ~count
+        0xFF, 0xFF,
+        0xFF // free space start
+    };
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, eeprom.flash.memory, sizeof(expected));
+
+    // Reload from flash
+    EepromEmu<EepromFlashDriver, 0x4499> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(expected));
+
+    TEST_ASSERT_EQUAL_HEX32(0x0000AA99, eeprom2.read_u32(3, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x11112222, eeprom2.read_u32(4, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x33334444, eeprom2.read_u32(5, 0));
+}
+
+void test_eeprom_group_torn() {
+    EepromEmu<EepromFlashDriver, 0x4499, 16> eeprom;
+
+    eeprom.write_u32(4, 1);
+    eeprom.write_u32(20, 2);
+
+    eeprom.begin();
+    eeprom.write_u32(4, 3);
+    eeprom.write_u32(20, 4);
+    eeprom.commit();
+
+    // Simulate power loss before group commit mark written
+    uint32_t commit_ofs = 8 + 8 * 4;
+    eeprom.flash.memory[commit_ofs + 0] = 0xFF;
+    eeprom.flash.memory[commit_ofs + 1] = 0xFF;
+
+    EepromEmu<EepromFlashDriver, 0x4499, 16> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, eeprom.flash.BankSize);
+
+    // Whole group should be discarded, both in index & scan modes
+    TEST_ASSERT_EQUAL_HEX32(1, eeprom2.read_u32(4, 0));
+    TEST_ASSERT_EQUAL_HEX32(2, eeprom2.read_u32(20, 0));
+
+    // Writes should continue after broken records
+    eeprom2.write_u32(4, 5);
+    TEST_ASSERT_EQUAL_HEX32(5, eeprom2.read_u32(4, 0));
+}
+
+void test_eeprom_group_queue_overflow() {
+    EepromEmu<EepromFlashDriver, 0x4499, 16, true> eeprom;
+
+    // Committed records, not flushed yet
+    for (uint32_t i = 0; i < 10; i++) eeprom.write_u32(i, 100 + i);
+
+    // Open group overflows queue
+    eeprom.begin();
+    for (uint32_t i = 0; i < 8; i++) eeprom.write_u32(20 + i, 200 + i);
+
+    // Simulate power loss before commit
+    EepromEmu<EepromFlashDriver, 0x4499, 16, true> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+    // Committed records are flushed, nothing from group is visible
+    TEST_ASSERT_EQUAL_HEX32(109, eeprom2.read_u32(9, 0));
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX32(0, eeprom2.read_u32(20 + i, 0));
+    }
+
+    eeprom.commit();
+    eeprom.flush();
+
+    EepromEmu<EepromFlashDriver, 0x4499, 16, true> eeprom3;
+    memcpy(eeprom3.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX32(200 + i, eeprom3.read_u32(20 + i, 0));
+    }
+    TEST_ASSERT_EQUAL(0, eeprom.flash.violations);
+}
+
+void test_eeprom_group_bank_move() {
+    EepromEmu<EepromFlashDriver, 0x4499> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 8) / 8;
+
+    eeprom.write_u32(7, 0x77);
+
+    // Leave single free record, not enough for group
+    for (uint32_t i = 0; i < capacity - 2u; i++) eeprom.write_u32(3, i);
+
+    eeprom.begin();
+    for (uint32_t i = 0; i < 8; i++) eeprom.write_u32(10 + i, 100 + i);
+    eeprom.commit();
+
+    // Data should move to second bank, group written after copied records
+    TEST_ASSERT_EQUAL_HEX8(0xFF, eeprom.flash.memory[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x77, eeprom.read_u32(7, 0));
+    TEST_ASSERT_EQUAL_HEX32(capacity - 3u, eeprom.read_u32(3, 0));
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX32(100 + i, eeprom.read_u32(10 + i, 0));
+    }
+
+    // Fill again, group records should survive next move
+    for (uint32_t i = 0; i < capacity; i++) eeprom.write_u32(3, i);
+
+    TEST_ASSERT_EQUAL_HEX8(0xEE, eeprom.flash.memory[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x77, eeprom.read_u32(7, 0));
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX32(100 + i, eeprom.read_u32(10 + i, 0));
+    }
+}
+void test_eeprom_async_write() {
+    EepromEmu<EepromFlashDriver, 0x4499, 16, true> eeprom;
+
+    eeprom.write_u32(3, 0x0000AA99);
+    eeprom.begin();
+    eeprom.write_u32(4, 0x11112222);
+    eeprom.write_u32(5, 0x33334444);
+
+    // Nothing written yet, but values are readable
+    TEST_ASSERT_EQUAL_HEX8(0xFF, eeprom.flash.memory[8]);
+    TEST_ASSERT_EQUAL_HEX32(0x0000AA99, eeprom.read_u32(3, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x33334444, eeprom.read_u32(5, 0));
+
+    // Open group should not be flushed
+    while (eeprom.tick()) {}
+    TEST_ASSERT_EQUAL_HEX8(0xFF, eeprom.flash.memory[16 + 2]);
+
+    eeprom.commit();
+
+    // Single flash operation per tick
+    uint32_t ticks = 0;
+    for (;;)
+    {
+        uint32_t ops = eeprom.flash.writes + eeprom.flash.erases;
+        if (!eeprom.tick()) break;
+        TEST_ASSERT_EQUAL(ops + 1, eeprom.flash.writes + eeprom.flash.erases);
+        ticks++;
+    }
+    // 2 group records + group commit
+    TEST_ASSERT_EQUAL(3 * 2 + 3, ticks);
+
+    // Layout should be the same as for sync writes
+    EepromEmu<EepromFlashDriver, 0x4499> sync;
+
+    sync.write_u32(3, 0x0000AA99);
+    sync.begin();
+    sync.write_u32(4, 0x11112222);
+    sync.write_u32(5, 0x33334444);
+    sync.commit();
+
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(sync.flash.memory, eeprom.flash.memory, 64);
+}
+
+void test_eeprom_async_bank_move() {
+    EepromEmu<EepromFlashDriver, 0x4499, 16, true> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 8) / 8;
+
+    eeprom.write_u32(7, 0x77);
+    eeprom.flush();
+    eeprom.write_u32(20, 0x2020);
+    eeprom.flush();
+
+    for (uint32_t i = 0; i < capacity - 2u; i++)
+    {
+        eeprom.write_u32(3, i);
+        eeprom.flush();
+    }
+
+    // Bank is full, next write needs move
+    eeprom.write_u32(3, 0x3333);
+
+    uint32_t ticks = 0;
+    bool ok = true;
+
+    for (;;)
+    {
+        uint32_t ops = eeprom.flash.writes + eeprom.flash.erases;
+        if (!eeprom.tick()) break;
+        ticks++;
+
+        if (eeprom.flash.writes + eeprom.flash.erases != ops + 1) ok = false;
+
+        // Data should be consistent at every step
+        if (eeprom.read_u32(7, 0) != 0x77) ok = false;
+        if (eeprom.read_u32(20, 0) != 0x2020) ok = false;
+        if (eeprom.read_u32(3, 0) != 0x3333) ok = false;
+
+        // Queue new writes in the middle of move
+        if (ticks == 5) eeprom.write_u32(8, 0x88);
+    }
+
+    TEST_ASSERT_TRUE(ok);
+
+    // Copy 2 records + header + 2 dirty marks + erase + new record
+    TEST_ASSERT_EQUAL(2 * 4 + 2 + 2 + 1 + 4 + 4, ticks);
+
+    TEST_ASSERT_EQUAL_HEX8(0xFF, eeprom.flash.memory[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xEE, eeprom.flash.memory[eeprom.flash.BankSize]);
+
+    TEST_ASSERT_EQUAL_HEX32(0x88, eeprom.read_u32(8, 0));
+
+    // Reload from flash
+    EepromEmu<EepromFlashDriver, 0x4499, 16> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+    TEST_ASSERT_EQUAL_HEX32(0x77, eeprom2.read_u32(7, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x2020, eeprom2.read_u32(20, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x3333, eeprom2.read_u32(3, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x88, eeprom2.read_u32(8, 0));
+}
+
+// Bank of 4 erase pages: one page erase per tick, both for dirty target
+// bank and for old bank cleanup.
+void test_eeprom_async_paged_erase() {
+    EepromEmu<EepromFlashDriverBanks<2, 2, EEPROM_LOCK_PER_OP, EEPROM_EMU_BANK_SIZE / 4>,
+        0x4499, 16, true> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 8) / 8;
+
+    // Garbage in the last page of unused bank
+    eeprom.flash.memory[eeprom.flash.BankSize * 2 - 10] = 0;
+
+    eeprom.write_u32(7, 0x77);
+    while (eeprom.tick()) {}
+
+    for (uint32_t i = 0; i < capacity - 1u; i++)
+    {
+        eeprom.write_u32(3, i);
+        while (eeprom.tick()) {}
+    }
+
+    TEST_ASSERT_EQUAL(0, eeprom.flash.erases);
+
+    eeprom.write_u32(3, 0x3333);
+
+    bool ok = true;
+
+    for (;;)
+    {
+        uint32_t ops = eeprom.flash.writes + eeprom.flash.erases;
+        if (!eeprom.tick()) break;
+        if (eeprom.flash.writes + eeprom.flash.erases > ops + 1) ok = false;
+    }
+
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL(8, eeprom.flash.erases);
+    TEST_ASSERT_EQUAL(1, eeprom.flash.bank_erases[0]);
+    TEST_ASSERT_EQUAL(1, eeprom.flash.bank_erases[1]);
+    TEST_ASSERT_EQUAL(0, eeprom.flash.violations);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, eeprom.flash.memory[0]);
+
+    TEST_ASSERT_EQUAL_HEX32(0x77, eeprom.read_u32(7, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x3333, eeprom.read_u32(3, 0));
+}
+
+void test_eeprom_banks_rotation() {
+    EepromEmu<EepromFlashDriverBanks<4>, 0x4499, 16> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 8) / 8;
+
+    eeprom.write_u32(7, 0x77);
+    eeprom.write_u32(20, 0x2020);
+
+    // Fill first bank
+    for (uint32_t i = 0; i < capacity - 2u; i++) eeprom.write_u32(3, i);
+
+    // Each next write should move data to next bank, in rotation
+    for (uint32_t bank = 1; bank <= 5; bank++)
+    {
+        for (uint32_t i = 0; i < capacity - 2u; i++) eeprom.write_u32(3, bank * 1000 + i);
+
+        for (uint32_t b = 0; b < 4; b++)
+        {
+            uint8_t expected = (b == bank % 4) ? 0xEE : 0xFF;
+            TEST_ASSERT_EQUAL_HEX8(expected, eeprom.flash.memory[b * eeprom.flash.BankSize]);
+        }
+
+        TEST_ASSERT_EQUAL_HEX32(0x77, eeprom.read_u32(7, 0));
+        TEST_ASSERT_EQUAL_HEX32(0x2020, eeprom.read_u32(20, 0));
+        TEST_ASSERT_EQUAL_HEX32(bank * 1000 + capacity - 3u, eeprom.read_u32(3, 0));
+    }
+
+    // Reload from flash
+    EepromEmu<EepromFlashDriverBanks<4>, 0x4499, 16> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+    TEST_ASSERT_EQUAL_HEX32(0x77, eeprom2.read_u32(7, 0));
+    TEST_ASSERT_EQUAL_HEX32(5000 + capacity - 3u, eeprom2.read_u32(3, 0));
+}
+
+void test_eeprom_banks_two_active() {
+    EepromEmu<EepromFlashDriverBanks<4>, 0x4499> eeprom;
+
+    // Bank 3 active with old data, bank 0 with new one (power lost before
+    // old bank cleanup)
+    uint8_t raw_old[] = {
+        0xEE, 0x77, 0xFF, 0xFF, 0x99, 0x44, 0xFF, 0xFF, // Bank header
+        0xAA, 0x55, 0x03, 0x00, 0x11, 0x11, 0x00, 0x00,
+        0xFF
+    };
+    uint8_t raw_new[] = {
+        0xEE, 0x77, 0xFF, 0xFF, 0x99, 0x44, 0xFF, 0xFF, // Bank header
+        0xAA, 0x55, 0x03, 0x00, 0x22, 0x22, 0x00, 0x00,
+        0xFF
+    };
+    memcpy(eeprom.flash.memory + eeprom.flash.BankSize * 3, raw_old, sizeof(raw_old));
+    memcpy(eeprom.flash.memory, raw_new, sizeof(raw_new));
+
+    TEST_ASSERT_EQUAL_HEX32(0x2222, eeprom.read_u32(3, 0));
+
+    // Old bank should be marked dirty
+    TEST_ASSERT_EQUAL_HEX8(0x55, eeprom.flash.memory[eeprom.flash.BankSize * 3 + 2]);
+}
+
+// Erases per bank for typical workload: few config values, rarely changed,
+// and frequently updated one (R thermal factor).
+template <uint8_t BANKS>
+static uint32_t max_bank_erases(uint32_t writes)
+{
+    EepromEmu<EepromFlashDriverBanks<BANKS>, 0x4499, 32> eeprom;
+
+    for (uint32_t i = 0; i < 20; i++) eeprom.write_u32(i, i);
+
+    for (uint32_t i = 0; i < writes; i++)
+    {
+        eeprom.write_u32(25, i);
+        if (i % 1000 == 0) eeprom.write_u32(i / 1000 % 20, i);
+    }
+
+    uint32_t max = 0;
+
+    for (uint32_t b = 0; b < BANKS; b++)
+    {
+        if (eeprom.flash.bank_erases[b] > max) max = eeprom.flash.bank_erases[b];
+    }
+
+    return max;
+}
+
+void test_eeprom_banks_wear() {
+    const uint32_t writes = 100000;
+
+    uint32_t wear2 = max_bank_erases<2>(writes);
+    uint32_t wear4 = max_bank_erases<4>(writes);
+    uint32_t wear8 = max_bank_erases<8>(writes);
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "Max erases per bank after %u writes: 2 banks %u, 4 banks %u, 8 banks %u",
+        (unsigned)writes, (unsigned)wear2, (unsigned)wear4, (unsigned)wear8);
+    TEST_MESSAGE(msg);
+
+    // With 10K cycles flash endurance
+    snprintf(msg, sizeof(msg), "Writes until 10K erase cycles: 2 banks %u, 4 banks %u, 8 banks %u",
+        (unsigned)(10000ULL * writes / wear2), (unsigned)(10000ULL * writes / wear4),
+        (unsigned)(10000ULL * writes / wear8));
+    TEST_MESSAGE(msg);
+
+    // Wear should spread evenly
+    TEST_ASSERT_UINT32_WITHIN(1, wear2 / 2, wear4);
+    TEST_ASSERT_UINT32_WITHIN(1, wear2 / 4, wear8);
+}
+
+void test_eeprom_torn_record() {
+    uint16_t capacity = (EepromFlashDriver::BankSize - 8) / 8;
+
+    // Power loss at every step of record write, at different fill levels
+    for (uint32_t fill = 1; fill < capacity; fill += 7)
+    {
+        for (uint32_t step = 0; step < 4; step++)
+        {
+            EepromEmu<EepromFlashDriver, 0x4499> eeprom;
+
+            for (uint32_t i = 0; i < fill; i++) eeprom.write_u32(3, i);
+
+            // Torn record: some half-words written, no commit mark
+            uint32_t ofs = 8 + fill * 8;
+            static const uint8_t order[] = { 2, 4, 6 };
+            for (uint32_t i = 0; i < step && ofs < eeprom.flash.BankSize; i++)
+            {
+                eeprom.flash.memory[ofs + order[i]] = 0x12;
+            }
+
+            EepromEmu<EepromFlashDriver, 0x4499> eeprom2;
+            memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+            TEST_ASSERT_EQUAL_HEX32(fill - 1, eeprom2.read_u32(3, 0xFFFF));
+
+            // Next write should go after torn record
+            eeprom2.write_u32(5, 0x55);
+            TEST_ASSERT_EQUAL_HEX32(0x55, eeprom2.read_u32(5, 0));
+
+            if (ofs + (step ? 8 : 0) < eeprom.flash.BankSize)
+            {
+                uint32_t new_ofs = ofs + (step ? 8 : 0);
+                TEST_ASSERT_EQUAL_HEX8(0x05, eeprom2.flash.memory[new_ofs + 2]);
+            }
+        }
+    }
+}
+
+void test_eeprom_free_space_gap() {
+    EepromEmu<EepromFlashDriver, 0x4499> eeprom;
+
+    for (uint32_t i = 0; i < 10; i++) eeprom.write_u32(3, i);
+
+    // Damaged flash: empty slot inside data
+    memset(eeprom.flash.memory + 8 + 4 * 8, 0xFF, 8);
+
+    EepromEmu<EepromFlashDriver, 0x4499> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+    // Slow scan should find real end of data
+    eeprom2.write_u32(5, 0x55);
+    TEST_ASSERT_EQUAL_HEX8(0x05, eeprom2.flash.memory[8 + 10 * 8 + 2]);
+    TEST_ASSERT_EQUAL_HEX32(9, eeprom2.read_u32(3, 0));
+}
+
+void test_eeprom_free_space_benchmark() {
+    EepromEmu<EepromFlashDriver, 0x4499> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 8) / 8;
+
+    // Fill bank almost completely
+    for (uint32_t i = 0; i < capacity - 1u; i++) eeprom.write_u32(3, i);
+
+    // Old linear scan, for comparison
+    auto t0 = std::chrono::high_resolution_clock::now();
+    uint32_t reads_before = eeprom.flash.reads;
+    uint32_t ofs = 8;
+
+    for (; ofs <= eeprom.flash.BankSize - 8; ofs += 8)
+    {
+        if ((eeprom.flash.read_u16(0, ofs + 0) == 0xFFFF) &&
+            (eeprom.flash.read_u16(0, ofs + 2) == 0xFFFF) &&
+            (eeprom.flash.read_u16(0, ofs + 4) == 0xFFFF) &&
+            (eeprom.flash.read_u16(0, ofs + 6) == 0xFFFF)) break;
+    }
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    uint32_t reads_linear = eeprom.flash.reads - reads_before;
+
+    TEST_ASSERT_EQUAL(8 + (capacity - 1) * 8, ofs);
+
+    // New instance init does binary search only (no index)
+    EepromEmu<EepromFlashDriver, 0x4499> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    eeprom2.begin();
+    auto t3 = std::chrono::high_resolution_clock::now();
+    uint32_t reads_binary = eeprom2.flash.reads;
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "Free space search, full bank: linear %u flash reads (%.0f ns), init with binary search %u flash reads (%.0f ns)",
+        (unsigned)reads_linear, std::chrono::duration<double, std::nano>(t1 - t0).count(),
+        (unsigned)reads_binary, std::chrono::duration<double, std::nano>(t3 - t2).count());
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_LESS_THAN(reads_linear / 4, reads_binary);
+
+    // Make sure position is correct
+    eeprom2.commit();
+    eeprom2.write_u32(5, 0x55);
+    TEST_ASSERT_EQUAL_HEX8(0x05, eeprom2.flash.memory[8 + (capacity - 1) * 8 + 2]);
+}
+
+
+void test_eeprom_index_read() {
+    EepromEmu<EepromFlashDriver, 0x4499, 16> eeprom;
+
+    eeprom.write_u32(3, 0x0000AA99);
+    eeprom.write_u32(5, 0x12345678);
+    eeprom.write_u32(3, 0x5577CCEE);
+    // Address out of index range
+    eeprom.write_u32(40, 0x00001111);
+
+    TEST_ASSERT_EQUAL_HEX32(0x5577CCEE, eeprom.read_u32(3, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x12345678, eeprom.read_u32(5, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x00001111, eeprom.read_u32(40, 0));
+    TEST_ASSERT_EQUAL_HEX32(0xFFFF0000, eeprom.read_u32(7, 0xFFFF0000));
+
+    // Index should be restored on init
+    EepromEmu<EepromFlashDriver, 0x4499, 16> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+    TEST_ASSERT_EQUAL_HEX32(0x5577CCEE, eeprom2.read_u32(3, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x12345678, eeprom2.read_u32(5, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x00001111, eeprom2.read_u32(40, 0));
+}
+
+
+void test_eeprom_index_bank_move() {
+    EepromEmu<EepromFlashDriver, 0x4499, 16> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 8) / 8;
+    uint32_t expected[10];
+
+    // Cause multiple bank moves
+    for (uint32_t i = 0; i < capacity * 3u; i++)
+    {
+        eeprom.write_u32(i % 10, i);
+        expected[i % 10] = i;
+    }
+
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX32(expected[i], eeprom.read_u32(i, 0xFFFFFFFF));
+    }
+}
+
+
+template <uint16_t ADDR_SPACE>
+static uint32_t bank_move_flash_reads(bool &data_ok)
+{
+    EepromEmu<EepromFlashDriver, 0x4499, ADDR_SPACE> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 8) / 8;
+    uint32_t expected[40];
+
+    for (uint32_t i = 0; i < 40; i++) expected[i] = 0xFFFFFFFF;
+
+    // Fill bank completely, odd addresses below index end, even above
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+        uint32_t addr = (i % 10) + ((i & 1) ? 0 : 30);
+        eeprom.write_u32(addr, i);
+        expected[addr] = i;
+    }
+
+    eeprom.flash.reads = 0;
+
+    // Overflow => bank move
+    eeprom.write_u32(100, 0x5555);
+
+    uint32_t reads = eeprom.flash.reads;
+
+    data_ok = eeprom.read_u32(100, 0) == 0x5555;
+
+    for (uint32_t addr = 0; addr < 40; addr++)
+    {
+        if (eeprom.read_u32(addr, 0xFFFFFFFF) != expected[addr]) data_ok = false;
+    }
+
+    return reads;
+}
+
+void test_eeprom_bank_move_benchmark() {
+    bool ok_scan, ok_bitmap;
+
+    uint32_t reads_scan = bank_move_flash_reads<0>(ok_scan);
+    uint32_t reads_bitmap = bank_move_flash_reads<32>(ok_bitmap);
+
+    TEST_ASSERT_TRUE(ok_scan);
+    TEST_ASSERT_TRUE(ok_bitmap);
+
+    char msg[120];
+    snprintf(msg, sizeof(msg), "Bank move, full bank: rescan %u flash reads, bitmap %u flash reads",
+        (unsigned)reads_scan, (unsigned)reads_bitmap);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_LESS_THAN(reads_scan, reads_bitmap);
+}
+
+
+// Boot-time config load from nearly full bank: 15 reads, as app does.
+template <uint16_t ADDR_SPACE>
+static uint32_t boot_load_flash_reads(EepromFlashDriver &src, double &ns)
+{
+    EepromEmu<EepromFlashDriver, 0x4499, ADDR_SPACE> eeprom;
+    memcpy(eeprom.flash.memory, src.memory, sizeof(src.memory));
+
+    auto start = std::chrono::steady_clock::now();
+
+    uint32_t sum = 0;
+    for (uint32_t addr = 1; addr <= 15; addr++) sum += eeprom.read_u32(addr, 0);
+
+    auto end = std::chrono::steady_clock::now();
+    ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    // All addresses 1..15 should be found
+    if (sum != 15 * 16 / 2) return 0;
+
+    return eeprom.flash.reads;
+}
+
+void test_eeprom_index_benchmark() {
+    EepromEmu<EepromFlashDriver, 0x4499> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 8) / 8;
+
+    // Fill bank except last record. Addresses 1..15 written first, then
+    // frequently updated one.
+    for (uint32_t addr = 1; addr <= 15; addr++) eeprom.write_u32(addr, addr);
+    for (uint32_t i = 15; i < capacity - 1u; i++) eeprom.write_u32(20, i);
+
+    double ns_scan, ns_index;
+    uint32_t reads_scan = boot_load_flash_reads<0>(eeprom.flash, ns_scan);
+    uint32_t reads_index = boot_load_flash_reads<32>(eeprom.flash, ns_index);
+
+    char msg[120];
+    snprintf(msg, sizeof(msg), "Boot config load, full bank: scan %u flash reads (%.0f ns), index %u flash reads (%.0f ns)",
+        (unsigned)reads_scan, ns_scan, (unsigned)reads_index, ns_index);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_TRUE(reads_index > 0);
+    TEST_ASSERT_LESS_THAN(reads_scan, reads_index);
+}
+
+typedef EepromFlashDriverBanks<2, 8, EEPROM_LOCK_PER_FLUSH> WideFlashDriver;
+
+void test_eeprom_wide_write() {
+    EepromEmu<WideFlashDriver, 0x4499> eeprom;
+
+    eeprom.write_u32(3, 0x0000AA99);
+
+    // 0x55AA ^ 0x0003 ^ 0xAA99 ^ 0x0000 = 0xFF30
+    uint8_t expected[] = {
+        0xEE, 0x77, 0xFF, 0xFF, 0x99, 0x44, 0xFF, 0xFF, // Bank header
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // Dirty mark slot
+        0x30, 0xFF,                 // checksum
+        0x03, 0x00,                 // addr
+        0x99, 0xAA, 0x00, 0x00,     // data
+        0xFF, 0xFF
+    };
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, eeprom.flash.memory, sizeof(expected));
+
+    eeprom.begin();
+    eeprom.write_u32(4, 0x44);
+    eeprom.write_u32(5, 0x55);
+    eeprom.commit();
+
+    EepromEmu<WideFlashDriver, 0x4499> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+    TEST_ASSERT_EQUAL_HEX32(0xAA99, eeprom2.read_u32(3, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x44, eeprom2.read_u32(4, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x55, eeprom2.read_u32(5, 0));
+
+    // Single double-word program per record, no re-programming
+    TEST_ASSERT_EQUAL(0, eeprom.flash.violations);
+}
+
+void test_eeprom_wide_torn_record() {
+    EepromEmu<WideFlashDriver, 0x4499> eeprom;
+
+    eeprom.write_u32(3, 1);
+    eeprom.write_u32(3, 2);
+
+    // Broken program of last record: data doesn't match checksum
+    eeprom.flash.memory[16 + 8 + 4] = 0x12;
+
+    EepromEmu<WideFlashDriver, 0x4499> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+    TEST_ASSERT_EQUAL_HEX32(1, eeprom2.read_u32(3, 0));
+
+    eeprom2.write_u32(3, 3);
+    TEST_ASSERT_EQUAL_HEX32(3, eeprom2.read_u32(3, 0));
+    TEST_ASSERT_EQUAL(0, eeprom2.flash.violations);
+}
+
+void test_eeprom_wide_bank_move() {
+    EepromEmu<WideFlashDriver, 0x4499> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 16) / 8;
+
+    eeprom.write_u32(7, 0x77);
+    for (uint32_t i = 0; i < capacity; i++) eeprom.write_u32(3, i);
+
+    TEST_ASSERT_EQUAL(1, eeprom.flash.erases);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, eeprom.flash.memory[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xEE, eeprom.flash.memory[eeprom.flash.BankSize]);
+
+    EepromEmu<WideFlashDriver, 0x4499> eeprom2;
+    memcpy(eeprom2.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+    TEST_ASSERT_EQUAL_HEX32(0x77, eeprom2.read_u32(7, 0));
+    TEST_ASSERT_EQUAL_HEX32(capacity - 1, eeprom2.read_u32(3, 0));
+    TEST_ASSERT_EQUAL(0, eeprom.flash.violations);
+}
+
+template <typename DRIVER>
+static void bank_move_unlocks(uint32_t expected)
+{
+    EepromEmu<DRIVER, 0x4499> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 8) / 8;
+
+    for (uint32_t addr = 1; addr <= 10; addr++) eeprom.write_u32(addr, addr);
+    for (uint32_t i = 10; i < capacity; i++) eeprom.write_u32(20, i);
+
+    TEST_ASSERT_EQUAL(0, eeprom.flash.erases);
+
+    uint32_t before = eeprom.flash.unlocks;
+    eeprom.write_u32(3, 0x3333);
+
+    TEST_ASSERT_EQUAL(1, eeprom.flash.erases);
+    TEST_ASSERT_EQUAL(0, eeprom.flash.violations);
+    TEST_ASSERT_FALSE(eeprom.flash.unlocked);
+
+    TEST_ASSERT_EQUAL(expected, eeprom.flash.unlocks - before);
+}
+
+void test_eeprom_lock_scope() {
+    // Move 10 records (new value of 3 pending) + new record + header +
+    // dirty marks & erase
+    bank_move_unlocks<EepromFlashDriverBanks<2, 2, EEPROM_LOCK_PER_RECORD>>(13);
+    bank_move_unlocks<EepromFlashDriverBanks<2, 2, EEPROM_LOCK_PER_FLUSH>>(1);
+    bank_move_unlocks<EepromFlashDriverBanks<2, 2, EEPROM_LOCK_PER_OP>>(0);
+}
+
+void test_eeprom_async_locked_between_ticks() {
+    EepromEmu<EepromFlashDriverBanks<2, 2, EEPROM_LOCK_PER_FLUSH>, 0x4499, 16, true> eeprom;
+
+    uint16_t capacity = (eeprom.flash.BankSize - 8) / 8;
+
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+        eeprom.write_u32(3, i);
+        eeprom.flush();
+    }
+
+    // Group write with bank move
+    eeprom.begin();
+    eeprom.write_u32(4, 0x4444);
+    eeprom.write_u32(5, 0x5555);
+    eeprom.commit();
+
+    bool ok = true;
+
+    while (eeprom.tick())
+    {
+        if (eeprom.flash.unlocked) ok = false;
+    }
+
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL(1, eeprom.flash.erases);
+    TEST_ASSERT_EQUAL(0, eeprom.flash.violations);
+    TEST_ASSERT_EQUAL_HEX32(0x5555, eeprom.read_u32(5, 0));
+}
+
+
 
 void setUp(void) {}
 void tearDown(void) {}
@@ -183,6 +958,28 @@ int main() {
     RUN_TEST(test_eeprom_bank_move);
     RUN_TEST(test_eeprom_float);
     RUN_TEST(test_eeprom_version_match);
+    RUN_TEST(test_eeprom_group_write);
+    RUN_TEST(test_eeprom_group_torn);
+    RUN_TEST(test_eeprom_group_queue_overflow);
+    RUN_TEST(test_eeprom_group_bank_move);
+    RUN_TEST(test_eeprom_async_write);
+    RUN_TEST(test_eeprom_async_bank_move);
+    RUN_TEST(test_eeprom_async_paged_erase);
+    RUN_TEST(test_eeprom_banks_rotation);
+    RUN_TEST(test_eeprom_banks_two_active);
+    RUN_TEST(test_eeprom_banks_wear);
+    RUN_TEST(test_eeprom_torn_record);
+    RUN_TEST(test_eeprom_free_space_gap);
+    RUN_TEST(test_eeprom_free_space_benchmark);
+    RUN_TEST(test_eeprom_index_read);
+    RUN_TEST(test_eeprom_index_bank_move);
+    RUN_TEST(test_eeprom_index_benchmark);
+    RUN_TEST(test_eeprom_bank_move_benchmark);
+    RUN_TEST(test_eeprom_wide_write);
+    RUN_TEST(test_eeprom_wide_torn_record);
+    RUN_TEST(test_eeprom_wide_bank_move);
+    RUN_TEST(test_eeprom_lock_scope);
+    RUN_TEST(test_eeprom_async_locked_between_ticks);
     return UNITY_END();
 }
 
@@ -0,0 +1,397 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include "eeprom_emu.h"
+#include "../test_eeprom_emu/eeprom_flash_driver.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+//
+// Power loss simulation. Driver stops working after given number of flash
+// operations (half-word programs & erases), by throwing exception. Failed
+// erase is done partially (power lost in the middle).
+//
+
+struct PowerLost {};
+
+template <typename DRIVER>
+class FailingFlashDriver : public DRIVER
+{
+public:
+    // Operations allowed before power loss, -1 = unlimited
+    int32_t ops_left = -1;
+    uint32_t ops = 0;
+
+    void erase(uint8_t bank, uint32_t addr)
+    {
+        if (ops_left == 0)
+        {
+            // Partial erase
+            memset(this->memory + bank * DRIVER::BankSize + addr, 0xFF, DRIVER::EraseSize / 2);
+            throw PowerLost();
+        }
+        if (ops_left > 0) ops_left--;
+        ops++;
+        DRIVER::erase(bank, addr);
+    }
+
+    void write_u16(uint8_t bank, uint32_t addr, uint16_t data)
+    {
+        if (ops_left == 0) throw PowerLost();
+        if (ops_left > 0) ops_left--;
+        ops++;
+        DRIVER::write_u16(bank, addr, data);
+    }
+
+    void write_u64(uint8_t bank, uint32_t addr, uint64_t data)
+    {
+        if (ops_left == 0) throw PowerLost();
+        if (ops_left > 0) ops_left--;
+        ops++;
+        DRIVER::write_u64(bank, addr, data);
+    }
+};
+
+typedef FailingFlashDriver<EepromFlashDriver> TestDriver;
+// Double-word program, single unlock per flush
+typedef FailingFlashDriver<EepromFlashDriverBanks<2, 8, EEPROM_LOCK_PER_FLUSH>> WideTestDriver;
+// Bank of 4 erase pages (F103-like)
+typedef FailingFlashDriver<EepromFlashDriverBanks<2, 2, EEPROM_LOCK_PER_OP,
+    EEPROM_EMU_BANK_SIZE / 4>> PagedTestDriver;
+
+enum { ADDRS = 24 };
+
+// Reference model, values by address (0 = not written)
+struct Model {
+    uint32_t val[ADDRS] = {};
+};
+
+// Test scenario: sequence of transactions (single writes & groups), with
+// enough writes to cause several bank moves. Fills model state after each
+// transaction, `done` is updated as soon as transaction is flushed.
+template <typename EEPROM>
+static void run_scenario(EEPROM &eeprom, Model *states, uint32_t max_states, uint32_t &done)
+{
+    Model m;
+    uint32_t seed = 12345;
+
+    done = 0;
+
+    states[0] = m;
+
+    while (done + 1 < max_states)
+    {
+        seed = seed * 1103515245 + 12345;
+
+        uint32_t group = (seed >> 16) % 4;
+
+        if (group < 2)
+        {
+            // Single write, hot addresses more often
+            uint32_t addr = (seed >> 8) % (group ? ADDRS : 4);
+            uint32_t v = done + 1;
+            m.val[addr] = v;
+            eeprom.write_u32(addr, v);
+        }
+        else
+        {
+            // Group of 2..7 records
+            uint32_t size = 2 + (seed >> 20) % 6;
+            eeprom.begin();
+            for (uint32_t i = 0; i < size; i++)
+            {
+                uint32_t addr = (i * 5 + (seed >> 8)) % ADDRS;
+                uint32_t v = ((done + 1) << 8) + i;
+                m.val[addr] = v;
+                eeprom.write_u32(addr, v);
+            }
+            eeprom.commit();
+        }
+
+        eeprom.flush();
+        done++;
+        states[done] = m;
+    }
+}
+
+template <typename EEPROM>
+static bool matches(EEPROM &eeprom, const Model &m)
+{
+    for (uint32_t addr = 0; addr < ADDRS; addr++)
+    {
+        if (eeprom.read_u32(addr, 0) != m.val[addr]) return false;
+    }
+    return true;
+}
+
+template <typename DRIVER, bool ASYNC>
+static void power_loss_at_every_step()
+{
+    static Model states[400];
+    const uint32_t max_states = 400;
+
+    // Count operations of clean run
+    EepromEmu<DRIVER, 0x4499, 16, ASYNC> clean;
+    uint32_t done;
+    run_scenario(clean, states, max_states, done);
+
+    uint32_t total_ops = clean.flash.ops;
+    uint32_t moves = clean.flash.erases;
+
+    TEST_ASSERT_GREATER_THAN(4, moves);
+    TEST_ASSERT_EQUAL(0, clean.flash.violations);
+
+    uint32_t failures = 0;
+
+    for (uint32_t k = 0; k < total_ops; k++)
+    {
+        EepromEmu<DRIVER, 0x4499, 16, ASYNC> eeprom;
+        eeprom.flash.ops_left = (int32_t)k;
+
+        bool lost = false;
+
+        try { run_scenario(eeprom, states, max_states, done); }
+        catch (PowerLost &) { lost = true; }
+
+        TEST_ASSERT_TRUE(lost);
+
+        // Recovered data should match state before interrupted transaction
+        // or after it, nothing between.
+        EepromEmu<DRIVER, 0x4499, 16> recovered;
+        memcpy(recovered.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+        bool ok = false;
+        if (matches(recovered, states[done])) ok = true;
+        else if (done + 1 < max_states && matches(recovered, states[done + 1]))
+        {
+            ok = true;
+            done++;
+        }
+
+        if (!ok)
+        {
+            if (!failures) printf("  Inconsistent state after power loss at op %u\n", (unsigned)k);
+            failures++;
+            continue;
+        }
+
+        // Should stay writable after recovery
+        recovered.write_u32(3, 0xABCD);
+        recovered.write_u32(30, 0x3030);
+
+        EepromEmu<DRIVER, 0x4499, 16> reloaded;
+        memcpy(reloaded.flash.memory, recovered.flash.memory, sizeof(recovered.flash.memory));
+
+        if (reloaded.read_u32(3, 0) != 0xABCD || reloaded.read_u32(30, 0) != 0x3030 ||
+            reloaded.read_u32(5, 0) != states[done].val[5])
+        {
+            if (!failures) printf("  Broken writes after recovery, power loss at op %u\n", (unsigned)k);
+            failures++;
+        }
+    }
+
+    char msg[120];
+    snprintf(msg, sizeof(msg), "Power loss at each of %u flash ops (%u erases): %u failures",
+        (unsigned)total_ops, (unsigned)moves, (unsigned)failures);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL(0, failures);
+}
+
+void test_eeprom_power_loss_sync() {
+    power_loss_at_every_step<TestDriver, false>();
+}
+
+void test_eeprom_power_loss_async() {
+    power_loss_at_every_step<TestDriver, true>();
+}
+
+void test_eeprom_power_loss_wide() {
+    power_loss_at_every_step<WideTestDriver, false>();
+    power_loss_at_every_step<WideTestDriver, true>();
+}
+
+void test_eeprom_power_loss_paged() {
+    power_loss_at_every_step<PagedTestDriver, false>();
+    power_loss_at_every_step<PagedTestDriver, true>();
+}
+
+static bool bank_active(const uint8_t *bank)
+{
+    return bank[0] == 0xEE && bank[1] == 0x77 && bank[2] == 0xFF && bank[3] == 0xFF &&
+        bank[4] == 0x99 && bank[5] == 0x44;
+}
+
+// Move from bank 1 back to bank 0, power lost at each step. When both
+// banks are active after that, new one (0) should win, not the last by
+// index.
+template <typename DRIVER>
+static void power_loss_two_active()
+{
+    const uint32_t bank_size = DRIVER::BankSize;
+
+    // Find write, which causes move 1 => 0
+    EepromEmu<DRIVER, 0x4499, 16> probe;
+    probe.write_u32(7, 0x77);
+
+    uint32_t v = 0;
+    while (probe.flash.memory[0] != 0xFF) probe.write_u32(3, ++v);
+    while (probe.flash.memory[bank_size] != 0xFF) probe.write_u32(3, ++v);
+
+    uint32_t v_move = v;
+
+    // State before that write
+    EepromEmu<DRIVER, 0x4499, 16> base;
+    base.write_u32(7, 0x77);
+    for (v = 1; v < v_move; v++) base.write_u32(3, v);
+
+    uint32_t both_active = 0;
+
+    for (int32_t k = 0; k < 100; k++)
+    {
+        EepromEmu<DRIVER, 0x4499, 16> eeprom;
+        memcpy(eeprom.flash.memory, base.flash.memory, sizeof(base.flash.memory));
+        eeprom.flash.ops_left = k;
+
+        try { eeprom.write_u32(3, v_move); }
+        catch (PowerLost &) {}
+
+        if (!bank_active(eeprom.flash.memory) ||
+            !bank_active(eeprom.flash.memory + bank_size)) continue;
+
+        both_active++;
+
+        EepromEmu<DRIVER, 0x4499, 16> recovered;
+        memcpy(recovered.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+        TEST_ASSERT_EQUAL_HEX32(v_move, recovered.read_u32(3, 0));
+        TEST_ASSERT_EQUAL_HEX32(0x77, recovered.read_u32(7, 0));
+        TEST_ASSERT_EQUAL(0, recovered.flash.violations);
+
+        // Once more, after cleanup
+        EepromEmu<DRIVER, 0x4499, 16> reloaded;
+        memcpy(reloaded.flash.memory, recovered.flash.memory, sizeof(recovered.flash.memory));
+
+        TEST_ASSERT_EQUAL_HEX32(v_move, reloaded.read_u32(3, 0));
+    }
+
+    TEST_ASSERT_GREATER_THAN(0, both_active);
+}
+
+void test_eeprom_power_loss_two_active() {
+    power_loss_two_active<TestDriver>();
+    // Wide flash has no dirty mark, both banks stay active until header
+    // page of old one is erased.
+    power_loss_two_active<FailingFlashDriver<EepromFlashDriverBanks<2, 8,
+        EEPROM_LOCK_PER_FLUSH, EEPROM_EMU_BANK_SIZE / 4>>>();
+}
+
+// Power loss on very first use (init of clean flash) & on init, when it
+// cleans second active bank.
+void test_eeprom_power_loss_init() {
+    for (int32_t k = 0; k < 4; k++)
+    {
+        EepromEmu<TestDriver, 0x4499> eeprom;
+        eeprom.flash.ops_left = k;
+
+        try { eeprom.write_u32(1, 1); }
+        catch (PowerLost &) {}
+
+        EepromEmu<TestDriver, 0x4499> recovered;
+        memcpy(recovered.flash.memory, eeprom.flash.memory, sizeof(eeprom.flash.memory));
+
+        uint32_t v = recovered.read_u32(1, 0);
+        TEST_ASSERT_TRUE(v == 0 || v == 1);
+
+        recovered.write_u32(1, 2);
+        TEST_ASSERT_EQUAL(2, recovered.read_u32(1, 0));
+    }
+}
+
+
+//
+// Endurance: randomized writes with periodic verification. Reports erases
+// per bank & flash operations per write.
+//
+
+template <uint8_t BANKS>
+static void endurance(uint32_t writes)
+{
+    EepromEmu<FailingFlashDriver<EepromFlashDriverBanks<BANKS>>, 0x4499, 32> eeprom;
+    uint32_t model[32] = {};
+    uint32_t seed = 1;
+
+    for (uint32_t i = 0; i < writes; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+
+        // 90% of writes go to 2 hot addresses
+        uint32_t r = (seed >> 16) % 100;
+        uint32_t addr = (r < 90) ? (r & 1) : 2 + r % 30;
+
+        if ((seed >> 8) % 16 == 0)
+        {
+            eeprom.begin();
+            for (uint32_t j = 0; j < 4; j++)
+            {
+                model[(addr + j * 7) % 32] = i + j;
+                eeprom.write_u32((addr + j * 7) % 32, i + j);
+            }
+            eeprom.commit();
+        }
+        else
+        {
+            model[addr] = i;
+            eeprom.write_u32(addr, i);
+        }
+
+        if (i % 100000 == 0)
+        {
+            for (uint32_t a = 0; a < 32; a++) TEST_ASSERT_EQUAL(model[a], eeprom.read_u32(a, 0));
+        }
+    }
+
+    for (uint32_t a = 0; a < 32; a++) TEST_ASSERT_EQUAL(model[a], eeprom.read_u32(a, 0));
+
+    uint32_t min = UINT32_MAX, max = 0;
+    for (uint32_t b = 0; b < BANKS; b++)
+    {
+        if (eeprom.flash.bank_erases[b] < min) min = eeprom.flash.bank_erases[b];
+        if (eeprom.flash.bank_erases[b] > max) max = eeprom.flash.bank_erases[b];
+    }
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "%u random writes, %u banks: erases per bank %u..%u, %.2f flash ops per write",
+        (unsigned)writes, (unsigned)BANKS, (unsigned)min, (unsigned)max,
+        (double)eeprom.flash.ops / writes);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_UINT32_WITHIN(1, min, max);
+}
+
+void test_eeprom_endurance() {
+    endurance<2>(2000000);
+    endurance<4>(2000000);
+}
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_eeprom_power_loss_init);
+    RUN_TEST(test_eeprom_power_loss_sync);
+    RUN_TEST(test_eeprom_power_loss_async);
+    RUN_TEST(test_eeprom_power_loss_wide);
+    RUN_TEST(test_eeprom_power_loss_paged);
+    RUN_TEST(test_eeprom_power_loss_two_active);
+    RUN_TEST(test_eeprom_endurance);
+    return UNITY_END();
+}
+
+#endif
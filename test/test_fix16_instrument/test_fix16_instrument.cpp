@@ -0,0 +1,84 @@
+#ifdef UNIT_TEST
+
+// Checks are always on here. `test_native_instrument` env enables them
+// for all tests.
+#ifndef FIX16_INSTRUMENT
+#define FIX16_INSTRUMENT 1
+#endif
+
+#include <unity.h>
+
+// Not linked to native tests, include implementation
+#include "../src/math/truncated_mean.cpp"
+#include "../src/math/fix16_instrument.h"
+
+#include <stdio.h>
+
+static fix16_t mul_site(fix16_t a, fix16_t b) { return fix16_mul(a, b); }
+
+void test_instrument_sites() {
+    fix16_instrument_reset();
+
+    mul_site(F16(100), F16(100));
+    TEST_ASSERT_EQUAL(0, fix16_instrument_overflows());
+
+    // 300 * 300 > 32767
+    mul_site(F16(300), F16(300));
+    TEST_ASSERT_EQUAL(1, fix16_instrument_overflows());
+
+    fix16_sub(fix16_minimum, F16(1));
+    fix16_div(F16(1), 0);
+    TEST_ASSERT_EQUAL(3, fix16_instrument_overflows());
+
+    // Operand ranges are recorded per site
+    Fix16Site *s = Fix16Site::list();
+    while (s && s->calls != 2) s = s->next;
+
+    TEST_ASSERT_NOT_NULL(s);
+    TEST_ASSERT_EQUAL(F16(100), s->a_min);
+    TEST_ASSERT_EQUAL(F16(300), s->a_max);
+    TEST_ASSERT_EQUAL(90000LL * 65536, s->r_max);
+}
+
+void test_truncated_mean_ranges() {
+    uint16_t buf[16];
+    uint32_t seed = 3;
+
+    fix16_instrument_reset();
+
+    // Real buffers (<= 8 samples) of 12-bit ADC, random & worst case
+    for (int i = 0; i < 10000; i++)
+    {
+        for (int j = 0; j < 8; j++)
+        {
+            seed = seed * 1103515245 + 12345;
+            buf[j] = (i & 1) ? (uint16_t)((seed >> 16) & 0xFFF) : ((j & 1) ? 4095 : 0);
+        }
+        truncated_mean(buf, 8, F16(1.1));
+    }
+
+    TEST_ASSERT_EQUAL(0, fix16_instrument_overflows());
+
+    // 16 samples near max => s^2 doesn't fit int32
+    for (int j = 0; j < 16; j++) buf[j] = 4000;
+    truncated_mean(buf, 16, F16(1.1));
+
+    TEST_ASSERT_TRUE(fix16_instrument_overflows() > 0);
+
+    fflush(stdout);
+    fix16_instrument_report(stdout);
+}
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_instrument_sites);
+    RUN_TEST(test_truncated_mean_ranges);
+    return UNITY_END();
+}
+
+#endif
@@ -0,0 +1,358 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include "../src/math/fix16_math.h"
+#include "../src/math/fix16_sinusize_table.h"
+#include "../src/math/fix16_recip.h"
+#include "../src/math/fixed.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+// Table is built at compile time
+static_assert(sinusize_table<6, true>.knots[0] == 0, "");
+static_assert(sinusize_table<6, true>.knots[64] == 32768, "");
+static_assert(sinusize_table<6, false>.knots[64] == 32768, "");
+
+static double sinusize_ref(double x)
+{
+    return (asin(x * 2 - 1) * 2 / M_PI + 1) / 2;
+}
+
+// Max abs error over full input range, in units of 1.0
+template <typename F>
+static double max_error(F fn)
+{
+    double max = 0;
+
+    for (int32_t x = 0; x < fix16_one; x += 7)
+    {
+        double err = fabs(fix16_to_float(fn(x)) - sinusize_ref(x / 65536.0));
+        if (err > max) max = err;
+    }
+    return max;
+}
+
+// Old approach: 512 uniform points, no interpolation
+static fix16_t sinusize_step_512(fix16_t x)
+{
+    static uint16_t table[512];
+
+    if (!table[511])
+    {
+        for (int i = 0; i < 512; i++)
+        {
+            double v = floor(sinusize_ref(i / 511.0) * 65536 + 0.5);
+            table[i] = (uint16_t)(v > 65535 ? 65535 : v);
+        }
+    }
+
+    return table[fix16_clamp(x, 0, fix16_one - 1) >> 7];
+}
+
+void test_sinusize_accuracy() {
+    double err_step = max_error(sinusize_step_512);
+    double err_uniform = max_error(sinusize_lookup<6, false>);
+    double err_non_uniform = max_error(sinusize_lookup<6, true>);
+    double err_small = max_error(sinusize_lookup<5, true>);
+
+    char msg[200];
+    snprintf(msg, sizeof(msg),
+        "Sinusize max error: 512 steps (1024 bytes) %.4f, "
+        "65 uniform (130 bytes) %.4f, 65 non-uniform (386 bytes) %.4f, 33 non-uniform (194 bytes) %.4f",
+        err_step, err_uniform, err_non_uniform, err_small);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_TRUE(err_non_uniform < err_step);
+    TEST_ASSERT_TRUE(err_small < err_step);
+    TEST_ASSERT_TRUE(err_non_uniform < 0.0025);
+}
+
+// Reciprocal slope gives the same result as division, +/- 1 LSB
+void test_sinusize_recip_slope() {
+    const SinusizeTable<6, true> &table = sinusize_table<6, true>;
+    int32_t max_diff = 0;
+
+    for (fix16_t x = 0; x <= fix16_one / 2; x++)
+    {
+        uint32_t lo = 0;
+        while (lo + 1 < 64 && table.knots[lo + 1] <= x) lo++;
+
+        uint32_t x0 = table.knots[lo];
+        uint32_t t = (((uint32_t)x - x0) << 16) / (table.knots[lo + 1] - x0);
+        if (t > 65536) t = 65536;
+
+        fix16_t expected = (fix16_t)(((lo << 16) + t) >> 7);
+        int32_t diff = sinusize_half(x, table) - expected;
+
+        if (diff < 0) diff = -diff;
+        if (diff > max_diff) max_diff = diff;
+    }
+
+    TEST_ASSERT_LESS_OR_EQUAL(1, max_diff);
+}
+
+static fix16_t sinusize(fix16_t x)
+{
+    return sinusize_lookup<SINUSIZE_TABLE_SIZE_BITS, SINUSIZE_TABLE_NON_UNIFORM>(x);
+}
+
+void test_sinusize_shape() {
+    fix16_t prev = 0;
+
+    TEST_ASSERT_EQUAL(0, sinusize(0));
+    TEST_ASSERT_EQUAL(0, sinusize(F16(-0.5)));
+    TEST_ASSERT_INT32_WITHIN(1, F16(0.5), sinusize(F16(0.5)));
+    TEST_ASSERT_TRUE(sinusize(F16(2.0)) <= fix16_one);
+    TEST_ASSERT_TRUE(sinusize(F16(2.0)) > F16(0.99));
+
+    for (int32_t x = 0; x < fix16_one; x++)
+    {
+        fix16_t y = sinusize(x);
+
+        // Monotonic
+        if (y < prev) TEST_FAIL_MESSAGE("Not monotonic");
+        prev = y;
+
+        // Symmetric
+        if (x > 0 && abs(y + sinusize(fix16_one - x) - fix16_one) > 1) TEST_FAIL_MESSAGE("Not symmetric");
+    }
+}
+
+// Max relative error of a / b, over wide range of magnitudes
+template <int ITERATIONS>
+static double recip_max_rel_error(int &mismatches)
+{
+    double max = 0;
+
+    mismatches = 0;
+    uint32_t seed = 5;
+
+    for (int i = 0; i < 200000; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        fix16_t b = (fix16_t)((seed >> 1) >> (seed & 15)) * ((seed & 16) ? -1 : 1);
+        seed = seed * 1103515245 + 12345;
+        fix16_t a = (fix16_t)(seed >> 1) * ((seed & 16) ? -1 : 1);
+
+        if (b == 0) continue;
+
+        // Should be bit-exact with truncated division, except huge results
+        int64_t q = ((int64_t)a << 16) / b;
+        if (q > -(1 << 24) && q < (1 << 24) && fix16_div_nr<ITERATIONS>(a, b) != q) mismatches++;
+
+        double exact = (double)a / b * 65536;
+
+        // Relative error has sense only for results with enough bits
+        if (fabs(exact) >= fix16_maximum || fabs(exact) < 65536) continue;
+
+        double err = fabs(fix16_div_nr<ITERATIONS>(a, b) - exact) / fabs(exact);
+        if (err > max) max = err;
+    }
+    return max;
+}
+
+void test_recip_accuracy() {
+    int mismatches1, mismatches2, mismatches3;
+    double err1 = recip_max_rel_error<1>(mismatches1);
+    double err2 = recip_max_rel_error<2>(mismatches2);
+    double err3 = recip_max_rel_error<3>(mismatches3);
+
+    char msg[220];
+    snprintf(msg, sizeof(msg), "NR division max relative error (results >= 1.0) / mismatches with fix16_div: "
+        "1 iteration %.2e / %d, 2 iterations %.2e / %d, 3 iterations %.2e / %d",
+        err1, mismatches1, err2, mismatches2, err3, mismatches3);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_TRUE(err1 < 1e-3);
+    // Limited by fix16 result truncation
+    TEST_ASSERT_TRUE(err2 < 2e-5);
+    TEST_ASSERT_EQUAL(0, mismatches2);
+}
+
+void test_recip_edge_cases() {
+    TEST_ASSERT_EQUAL(fix16_minimum, fix16_div_nr(F16(1), 0));
+    TEST_ASSERT_EQUAL(F16(0.5), fix16_div_nr(F16(1), F16(2)));
+    TEST_ASSERT_EQUAL(F16(-0.5), fix16_div_nr(F16(1), F16(-2)));
+    TEST_ASSERT_EQUAL(F16(0.5), fix16_div_nr(F16(-1), F16(-2)));
+    TEST_ASSERT_INT32_WITHIN(1, F16(3), fix16_div_nr(F16(300), F16(100)));
+    TEST_ASSERT_INT32_WITHIN(1, F16(1000), fix16_div_nr(F16(1000), fix16_one));
+    TEST_ASSERT_EQUAL(fix16_maximum, fix16_div_nr(F16(30000), F16(0.1)));
+    TEST_ASSERT_EQUAL(fix16_minimum, fix16_div_nr(F16(-30000), F16(0.1)));
+    // Near fix16 limit error is ~1e-8 relative, a few LSB
+    TEST_ASSERT_INT32_WITHIN(32, 0x7FFF0000, fix16_div_nr(0x7FFF0000, fix16_one));
+
+    // Prepared reciprocal
+    fix16_recip_t inv = fix16_recip_prepare(F16(450));
+    TEST_ASSERT_INT32_WITHIN(1, fix16_div(F16(90), F16(450)), fix16_mul_recip(F16(90), inv));
+}
+
+void test_recip_benchmark() {
+    const int count = 1000000;
+    volatile fix16_t sink = 0;
+    uint32_t seed = 9;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        sink = sink + fix16_div(F16(1.2), (fix16_t)(seed >> 16) + 1);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        sink = sink + fix16_div_nr(F16(1.2), (fix16_t)(seed >> 16) + 1);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    fix16_recip_t inv = fix16_recip_prepare(F16(3.3));
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        sink = sink + fix16_mul_recip((fix16_t)(seed >> 16), inv);
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    // Host has hardware divider, so timings only show overhead. On M0 NR
+    // replaces software division loop with multiplies.
+    char msg[220];
+    snprintf(msg, sizeof(msg), "Host ns per op: fix16_div %.1f, NR division %.1f, cached reciprocal %.1f. "
+        "NR division = %d 32x32->64 multiplies (with last bit fix), no divisions",
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / count,
+        std::chrono::duration<double, std::nano>(t2 - t1).count() / count,
+        std::chrono::duration<double, std::nano>(t3 - t2).count() / count,
+        FIX16_RECIP_ITERATIONS * 2 + 3);
+    TEST_MESSAGE(msg);
+}
+
+// Product type is selected by format width
+static_assert(sizeof((Fixed<0, 12>() * Fixed<7, 12>()).raw) == 4, "");
+static_assert(sizeof((Fixed<9, 16>() * Fixed<7, 16>()).raw) == 8, "");
+static_assert(FixedSum<Fixed<16, 32>, 1000>::sum_t::INT == 26, "");
+
+void test_fixed() {
+    typedef Fixed<0, 12> adc_t;
+    typedef Fixed<7, 12> scale_t;
+
+    TEST_ASSERT_EQUAL(F16(1.5), (Fixed<3, 8>::from_fix16(F16(1.5))).to_fix16());
+    TEST_ASSERT_EQUAL(F16(-1.5), (Fixed<3, 20>::from_fix16(F16(-1.5))).to_fix16());
+    TEST_ASSERT_INT32_WITHIN(1, F16(0.3), (Fixed<3, 20>::from_double(0.3)).to_fix16());
+
+    // ADC 0.5 * 100 => exact 50
+    fix16_t r = (adc_t::from_raw(2048) * scale_t::from_double(100.0)).to_fix16();
+    TEST_ASSERT_EQUAL(F16(50), r);
+
+    // Precise coefficient, 1/1000 in Q30 vs F16(0.001) (~0.7% error)
+    fix16_t x = F16(123.456);
+    fix16_t precise = (Fixed<15, 16>::from_fix16(x) * Fixed<0, 30>::from_double(0.001)).to_fix16();
+    TEST_ASSERT_INT32_WITHIN(1, F16(0.123456), precise);
+    TEST_ASSERT_TRUE(abs(fix16_mul(x, F16(0.001)) - F16(0.123456)) > 50);
+
+    // Format conversion
+    TEST_ASSERT_EQUAL(F16(-2.25), (Fixed<3, 8>::from_fix16(F16(-2.25)).to<10, 30>()).to_fix16());
+
+    // Sum doesn't overflow
+    FixedSum<Fixed<16, 32>, 1000> sum;
+    sum.reset();
+    for (int i = 0; i < 1000; i++) sum.add(Fixed<16, 32>::from_double(30000.0));
+    TEST_ASSERT_EQUAL(F16(30000), (sum.sum.to<26, 16>().raw / 1000));
+}
+
+// Old normalization, bit by bit
+static fix16_t ratio_loop(uint64_t a, uint64_t b)
+{
+    while (a & 0xFFFFFFFF80000000UL) { a >>= 1; b >>= 1; }
+
+    if (b == 0) return fix16_minimum;
+
+    return fix16_div((fix16_t)a, (fix16_t)b);
+}
+
+void test_clz() {
+    TEST_ASSERT_EQUAL(64, clz64(0));
+    TEST_ASSERT_EQUAL(63, clz64(1));
+    TEST_ASSERT_EQUAL(0, clz64(0x8000000000000000ULL));
+    TEST_ASSERT_EQUAL(31, clz64(0x100000000ULL));
+
+    for (int i = 0; i < 32; i++)
+    {
+        uint32_t v = 0x80000000u >> i;
+
+        if (clz32_soft(v) != i) TEST_FAIL_MESSAGE("Bad soft CLZ");
+        if (clz32_soft(v | 1) != i) TEST_FAIL_MESSAGE("Bad soft CLZ");
+    }
+}
+
+void test_ratio64() {
+    uint32_t seed = 11;
+
+    // P / I^2 sums in Q32, R in [1..500] Ohm, up to 1000 samples
+    for (int i = 0; i < 100000; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        uint64_t i2 = ((uint64_t)seed << (seed & 15)) + 1;
+        seed = seed * 1103515245 + 12345;
+        uint64_t p = i2 * ((seed >> 8) % 500 + 1) + (seed & 0xFF);
+
+        if (fix16_ratio64(p, i2) != ratio_loop(p, i2)) TEST_FAIL_MESSAGE("Ratio mismatch");
+    }
+
+    TEST_ASSERT_EQUAL(F16(20), fix16_ratio64(20ULL << 40, 1ULL << 40));
+    TEST_ASSERT_EQUAL(F16(0.5), fix16_ratio64(1, 2));
+    TEST_ASSERT_EQUAL(fix16_minimum, fix16_ratio64(1ULL << 50, 1));
+    TEST_ASSERT_EQUAL(fix16_minimum, fix16_ratio64(5, 0));
+}
+
+void test_ratio64_benchmark() {
+    const int count = 1000000;
+    volatile fix16_t sink = 0;
+    uint32_t seed = 13;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        sink = sink + ratio_loop((uint64_t)seed << 28, ((uint64_t)seed << 24) + 1);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        sink = sink + fix16_ratio64((uint64_t)seed << 28, ((uint64_t)seed << 24) + 1);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    // Sums of 1000 samples have ~60 bits => ~29 loop iterations, each
+    // with 2 64-bit shifts (4 instructions on M0 instead of 1 on host).
+    char msg[160];
+    snprintf(msg, sizeof(msg), "Host ns per 64/64 ratio: shift loop %.1f, CLZ %.1f",
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / count,
+        std::chrono::duration<double, std::nano>(t2 - t1).count() / count);
+    TEST_MESSAGE(msg);
+}
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_sinusize_accuracy);
+    RUN_TEST(test_sinusize_recip_slope);
+    RUN_TEST(test_sinusize_shape);
+    RUN_TEST(test_recip_accuracy);
+    RUN_TEST(test_recip_edge_cases);
+    RUN_TEST(test_recip_benchmark);
+    RUN_TEST(test_fixed);
+    RUN_TEST(test_clz);
+    RUN_TEST(test_ratio64);
+    RUN_TEST(test_ratio64_benchmark);
+    return UNITY_END();
+}
+
+#endif
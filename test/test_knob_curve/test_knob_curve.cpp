@@ -0,0 +1,133 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include "../src/math/knob_curve.h"
+
+#include <stdlib.h>
+
+static const fix16_t linear_points[KNOB_CURVE_POINTS_COUNT] = {
+    0, F16(0.25), F16(0.5), F16(0.75), F16(1.0)
+};
+
+void test_knob_curve_linear() {
+    KnobCurve curve;
+    fix16_t dz = F16(0.02), min = F16(0.13), max = F16(0.8);
+
+    curve.configure(KNOB_CURVE_LINEAR, dz, 0, min, max, linear_points);
+
+    TEST_ASSERT_EQUAL(0, curve.map(0));
+    TEST_ASSERT_EQUAL(0, curve.map(F16(0.019)));
+    TEST_ASSERT_INT32_WITHIN(2, min, curve.map(dz));
+    TEST_ASSERT_EQUAL(max, curve.map(fix16_one));
+
+    // The same as old direct formula
+    for (fix16_t knob = dz; knob <= fix16_one; knob += 17)
+    {
+        fix16_t expected = min + fix16_div(fix16_mul(knob - dz, max - min), fix16_one - dz);
+
+        if (abs(curve.map(knob) - expected) > 8) TEST_FAIL_MESSAGE("Linear curve mismatch");
+    }
+}
+
+void test_knob_curve_exponential() {
+    KnobCurve curve;
+    fix16_t min = F16(0.1), max = F16(0.9);
+
+    curve.configure(KNOB_CURVE_EXPONENTIAL, 0, 0, min, max, linear_points);
+
+    TEST_ASSERT_INT32_WITHIN(2, min, curve.map(0));
+    TEST_ASSERT_INT32_WITHIN(2, max, curve.map(fix16_one));
+    // Finer control at low speed
+    TEST_ASSERT_TRUE(curve.map(F16(0.5)) < F16(0.3));
+
+    fix16_t prev = 0;
+
+    for (fix16_t knob = 0; knob <= fix16_one; knob += 13)
+    {
+        fix16_t out = curve.map(knob);
+
+        if (out < prev) TEST_FAIL_MESSAGE("Not monotonic");
+        prev = out;
+    }
+}
+
+void test_knob_curve_user_points() {
+    KnobCurve curve;
+    const fix16_t points[KNOB_CURVE_POINTS_COUNT] = {
+        0, F16(0.1), F16(0.2), F16(0.5), F16(1.0)
+    };
+
+    curve.configure(KNOB_CURVE_USER_POINTS, 0, 0, 0, fix16_one, points);
+
+    for (int i = 0; i < KNOB_CURVE_POINTS_COUNT; i++)
+    {
+        fix16_t knob = fix16_one * i / (KNOB_CURVE_POINTS_COUNT - 1);
+
+        TEST_ASSERT_INT32_WITHIN(2, points[i], curve.map(knob));
+    }
+
+    // Interpolated between points
+    TEST_ASSERT_INT32_WITHIN(2, F16(0.35), curve.map(F16(0.625)));
+}
+
+void test_knob_curve_hysteresis() {
+    KnobCurve curve;
+    fix16_t dz = F16(0.02), h = F16(0.005);
+
+    curve.configure(KNOB_CURVE_LINEAR, dz, h, F16(0.1), F16(0.9), linear_points);
+
+    // Knob raised to 0.5 + noise
+    fix16_t out = curve.map(F16(0.5) + h / 2);
+    uint32_t seed = 7;
+
+    // Noise within hysteresis is filtered out
+    for (int i = 0; i < 1000; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        fix16_t noise = (fix16_t)((seed >> 16) % h) - h / 2;
+
+        if (curve.map(F16(0.5) + noise) != out) TEST_FAIL_MESSAGE("Noise passed");
+    }
+
+    // Ends are reachable
+    TEST_ASSERT_EQUAL(F16(0.9), curve.map(fix16_one));
+    TEST_ASSERT_EQUAL(0, curve.map(0));
+
+    // Start after dead zone + hysteresis
+    TEST_ASSERT_EQUAL(0, curve.map(dz + h - 10));
+    TEST_ASSERT_TRUE(curve.map(dz + h + 10) > 0);
+}
+
+void test_knob_curve_hysteresis_over_dead_zone() {
+    KnobCurve curve;
+
+    // Hysteresis >= dead zone, motor should stop at zero knob anyway
+    curve.configure(KNOB_CURVE_LINEAR, F16(0.02), F16(0.05), F16(0.1), F16(0.9), linear_points);
+
+    TEST_ASSERT_TRUE(curve.map(F16(0.5)) > 0);
+    TEST_ASSERT_EQUAL(0, curve.map(0));
+
+    // No dead zone => no hysteresis, zero knob gives min speed as before
+    curve.configure(KNOB_CURVE_LINEAR, 0, F16(0.05), F16(0.1), F16(0.9), linear_points);
+
+    TEST_ASSERT_EQUAL(F16(0.9), curve.map(fix16_one));
+    TEST_ASSERT_INT32_WITHIN(2, F16(0.1), curve.map(0));
+}
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_knob_curve_linear);
+    RUN_TEST(test_knob_curve_exponential);
+    RUN_TEST(test_knob_curve_user_points);
+    RUN_TEST(test_knob_curve_hysteresis);
+    RUN_TEST(test_knob_curve_hysteresis_over_dead_zone);
+    return UNITY_END();
+}
+
+#endif
@@ -5,6 +5,11 @@
 #include "../src/math/fix16_math.h"
 #include "../src/math/median.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+
 // samples from `/doc/data`
 fix16_t data[] = {
     F16(0.4754093567),
@@ -141,6 +146,170 @@ void test_median_64() {
 }
 
 
+// Reference: median of first SIZE values via std::nth_element
+static fix16_t median_ref(const fix16_t *src, int len, int size)
+{
+    fix16_t buf[256];
+    int n = len < size ? len : size;
+
+    if (n == 0) return 0;
+
+    std::copy(src, src + n, buf);
+
+    std::nth_element(buf, buf + n / 2, buf + n);
+    fix16_t hi = buf[n / 2];
+
+    if (n & 1) return hi;
+
+    std::nth_element(buf, buf + n / 2 - 1, buf + n);
+    return (buf[n / 2 - 1] + hi) / 2;
+}
+
+template <int SIZE>
+static int median_mismatches(uint32_t &seed)
+{
+    MedianIteratorTemplate<fix16_t, SIZE> m;
+    fix16_t src[256];
+    int errors = 0;
+
+    for (int pass = 0; pass < 200; pass++)
+    {
+        m.reset();
+
+        // Random length (incl. overflow), and narrow range for duplicates
+        seed = seed * 1103515245 + 12345;
+        int len = (seed >> 16) % (SIZE * 2 + 1);
+        int range = (pass & 1) ? 8 : 1000000;
+
+        for (int i = 0; i < len; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            src[i] = (fix16_t)((seed >> 8) % range) - range / 2;
+            m.add(src[i]);
+
+            if (m.result() != median_ref(src, i + 1, SIZE)) errors++;
+        }
+
+        if (m.result() != median_ref(src, len, SIZE)) errors++;
+    }
+
+    return errors;
+}
+
+void test_median_vs_nth_element() {
+    uint32_t seed = 1;
+
+    TEST_ASSERT_EQUAL(0, median_mismatches<2>(seed));
+    TEST_ASSERT_EQUAL(0, median_mismatches<3>(seed));
+    TEST_ASSERT_EQUAL(0, median_mismatches<7>(seed));
+    TEST_ASSERT_EQUAL(0, median_mismatches<8>(seed));
+    TEST_ASSERT_EQUAL(0, median_mismatches<9>(seed));
+    TEST_ASSERT_EQUAL(0, median_mismatches<12>(seed));
+    TEST_ASSERT_EQUAL(0, median_mismatches<32>(seed));
+    TEST_ASSERT_EQUAL(0, median_mismatches<33>(seed));
+    TEST_ASSERT_EQUAL(0, median_mismatches<64>(seed));
+}
+
+template <int SIZE>
+static int sliding_median_mismatches(uint32_t &seed)
+{
+    SlidingMedianTemplate<fix16_t, SIZE> m;
+    static fix16_t src[2000];
+    int errors = 0;
+
+    for (int pass = 0; pass < 4; pass++)
+    {
+        m.reset();
+
+        int range = (pass & 1) ? 8 : 1000000;
+
+        for (int i = 0; i < 2000; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            src[i] = (fix16_t)((seed >> 8) % range) - range / 2;
+            m.add(src[i]);
+
+            int start = i + 1 > SIZE ? i + 1 - SIZE : 0;
+            if (m.result() != median_ref(src + start, i + 1 - start, SIZE)) errors++;
+        }
+    }
+
+    return errors;
+}
+
+void test_sliding_median_vs_nth_element() {
+    uint32_t seed = 1;
+
+    TEST_ASSERT_EQUAL(0, sliding_median_mismatches<1>(seed));
+    TEST_ASSERT_EQUAL(0, sliding_median_mismatches<2>(seed));
+    TEST_ASSERT_EQUAL(0, sliding_median_mismatches<5>(seed));
+    TEST_ASSERT_EQUAL(0, sliding_median_mismatches<8>(seed));
+    TEST_ASSERT_EQUAL(0, sliding_median_mismatches<31>(seed));
+    TEST_ASSERT_EQUAL(0, sliding_median_mismatches<127>(seed));
+}
+
+void test_sliding_median_spike() {
+    SlidingMedianTemplate<fix16_t, 5> m;
+
+    for (int i = 0; i < 5; i++) m.add(F16(1));
+
+    TEST_ASSERT_TRUE(m.is_full());
+
+    // Single spike is dropped immediately, no block delay
+    m.add(F16(10));
+    TEST_ASSERT_EQUAL(F16(1), m.result());
+    m.add(F16(1));
+    TEST_ASSERT_EQUAL(F16(1), m.result());
+
+    // Step is followed after half of window
+    m.reset();
+    for (int i = 0; i < 5; i++) m.add(F16(1));
+
+    m.add(F16(2));
+    m.add(F16(2));
+    TEST_ASSERT_EQUAL(F16(1), m.result());
+    m.add(F16(2));
+    TEST_ASSERT_EQUAL(F16(2), m.result());
+}
+
+template <int SIZE>
+static double median_ns_per_sample()
+{
+    static fix16_t src[SIZE];
+    MedianIteratorTemplate<fix16_t, SIZE> m;
+    uint32_t seed = 7;
+    volatile fix16_t sink = 0;
+    const int passes = 20000;
+
+    for (int i = 0; i < SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        src[i] = (fix16_t)(seed >> 12);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+        m.reset();
+        for (int i = 0; i < SIZE; i++) m.add(src[i] + pass);
+        sink = sink + m.result();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / passes / SIZE;
+}
+
+void test_median_benchmark() {
+    char msg[200];
+
+    snprintf(msg, sizeof(msg), "Median, ns per sample: size 6 %.1f, size 32 %.1f, size 64 %.1f",
+        median_ns_per_sample<6>(), median_ns_per_sample<32>(), median_ns_per_sample<64>());
+    TEST_MESSAGE(msg);
+}
+
+
 void setUp(void) {}
 void tearDown(void) {}
 
@@ -155,6 +324,10 @@ int main() {
     RUN_TEST(test_median_5_el);
     RUN_TEST(test_median_overflow);
     RUN_TEST(test_median_64);
+    RUN_TEST(test_median_vs_nth_element);
+    RUN_TEST(test_sliding_median_vs_nth_element);
+    RUN_TEST(test_sliding_median_spike);
+    RUN_TEST(test_median_benchmark);
     UNITY_END();
 }
 
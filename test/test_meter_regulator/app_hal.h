@@ -0,0 +1,22 @@
+#ifndef __APP_HAL__
+#define __APP_HAL__
+
+// HAL stub for host simulation of Io + Meter + Regulator. Values are the
+// same as on hw_v1 (STM32F103).
+
+#include <stdint.h>
+
+#define ADC_FETCH_PER_TICK 8
+#define ADC_CHANNELS_COUNT 4
+#define APP_TICK_FREQUENCY 17857
+
+namespace hal {
+
+void setup();
+void start();
+void triac_ignition_on();
+void triac_ignition_off();
+
+} // namespace
+
+#endif
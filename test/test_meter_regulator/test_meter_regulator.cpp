@@ -0,0 +1,308 @@
+#ifdef UNIT_TEST
+
+//
+// Host simulation of the whole processing chain: Io => Meter => Regulator,
+// with simple universal motor model. Runs with fix16 overflow checks, to
+// collect evidence of value ranges in real conditions.
+//
+
+#ifndef FIX16_INSTRUMENT
+#define FIX16_INSTRUMENT 1
+#endif
+
+#include <unity.h>
+
+// Not linked to native tests, include implementation
+#include "../src/math/fix16_math.cpp"
+#include "../src/math/truncated_mean.cpp"
+
+#include "app.h"
+
+// Check coroutines backend too, when compiler supports it
+#if defined(__cpp_impl_coroutine) && !defined(YIELD_USE_COROUTINES)
+#define YIELD_USE_COROUTINES
+#endif
+#include "calibrator/calibrator_wait_knob_dial.h"
+
+#include <math.h>
+#include <stdio.h>
+
+config_t config;
+Io io;
+Meter meter;
+Regulator regulator;
+
+void config_write(cfg_id_t id, fix16_t val) {
+    *(uint32_t *)((uint8_t *)&config + cfg_schema[id].offset) = cfg_clamp(cfg_schema[id], (uint32_t)val);
+}
+
+void eeprom_group_begin() {}
+void eeprom_group_commit() {}
+
+static bool triac_gate = false;
+
+namespace hal {
+
+void setup() {}
+void start() {}
+void triac_ignition_on() { triac_gate = true; }
+void triac_ignition_off() { triac_gate = false; }
+
+} // namespace
+
+struct DefaultsEeprom {
+    uint32_t read_u32(uint32_t, uint32_t dflt) { return dflt; }
+};
+
+//
+// Motor: resistive load R + back-EMF equivalent R (proportional to speed),
+// torque ~ I^2, load torque ~ speed.
+//
+#define SIM_R_MOTOR 60.0
+#define SIM_REKV_TO_SPEED 450.0
+#define SIM_V_REF 3.3
+
+class MotorSim
+{
+public:
+    double speed = 0;
+    double load = 1.0;
+    // Heating changes winding resistance
+    double r_motor = SIM_R_MOTOR;
+    // Keep speed constant (rotor spinning by inertia / external force)
+    bool speed_fixed = false;
+
+    double knob = 0;
+
+    uint16_t adc_voltage_buf[ADC_FETCH_PER_TICK];
+    uint16_t adc_current_buf[ADC_FETCH_PER_TICK];
+    uint16_t adc_knob_buf[ADC_FETCH_PER_TICK];
+    uint16_t adc_v_refin_buf[ADC_FETCH_PER_TICK];
+
+    void tick()
+    {
+        double dt = 1.0 / APP_TICK_FREQUENCY;
+        double v = 230 * M_SQRT2 * sin(2 * M_PI * 50 * t);
+
+        t += dt;
+
+        // Triac closes at current zero cross
+        if ((v > 0) != (prev_v > 0)) conducting = false;
+        if (triac_gate) conducting = true;
+        prev_v = v;
+
+        double i = conducting ? v / (r_motor + SIM_REKV_TO_SPEED * speed) : 0;
+
+        if (!speed_fixed)
+        {
+            speed += dt / 0.3 * (2.67 * i * i - load * speed);
+            if (speed < 0) speed = 0;
+        }
+
+        // Voltage & current sensors measure positive half-wave only
+        for (int s = 0; s < ADC_FETCH_PER_TICK; s++)
+        {
+            adc_voltage_buf[s] = adc(v / (SIM_V_REF * 201));
+            adc_current_buf[s] = adc(i / (20.0 / 10.0 * SIM_V_REF));
+            adc_knob_buf[s] = adc(knob);
+            adc_v_refin_buf[s] = adc(1.2 / SIM_V_REF);
+        }
+    }
+
+private:
+    double t = 0;
+    double prev_v = 0;
+    bool conducting = false;
+    uint32_t seed = 1;
+
+    // [0..1] => 12-bit ADC value with +/- 2 LSB noise. Negative input
+    // (below sensor range) gives clean zero.
+    uint16_t adc(double val)
+    {
+        if (val <= 0) return 0;
+
+        seed = seed * 1103515245 + 12345;
+        int x = (int)(val * 4096) + (int)((seed >> 16) % 5) - 2;
+
+        return (uint16_t)(x < 0 ? 0 : (x > 4095 ? 4095 : x));
+    }
+};
+
+static MotorSim sim;
+
+static void setup_app()
+{
+    DefaultsEeprom eeprom;
+
+    cfg_load(eeprom, config);
+
+    // Calibrated flat R table
+    for (int i = 0; i < CFG_R_INTERP_TABLE_LENGTH; i++) config.r_interp_table[i] = F16(SIM_R_MOTOR);
+    config.rekv_to_speed_factor = F16(SIM_REKV_TO_SPEED);
+
+    io.configure();
+    regulator.configure();
+    meter.configure();
+
+    sim = MotorSim();
+    triac_gate = false;
+}
+
+// The same as main loop in `app.cpp`. `setpoint` < 0 => regulator is
+// used, otherwise triac setpoint is forced.
+static void run(double seconds, fix16_t setpoint = -1)
+{
+    int ticks = (int)(seconds * APP_TICK_FREQUENCY);
+
+    for (int t = 0; t < ticks; t++)
+    {
+        sim.tick();
+        io.consume(sim.adc_voltage_buf, sim.adc_current_buf, sim.adc_knob_buf, sim.adc_v_refin_buf);
+
+        io_data_t io_data;
+
+        while (io.out.pop(io_data))
+        {
+            meter.tick(io_data);
+
+            if (setpoint < 0)
+            {
+                regulator.tick(io_data.knob, meter.speed);
+                io.setpoint = regulator.out_power;
+            }
+            else io.setpoint = setpoint;
+        }
+    }
+}
+
+
+void test_no_overflows_in_real_work() {
+    setup_app();
+    fix16_instrument_reset();
+
+    // Start, ramp knob up, load change, slow speed, stop
+    run(1.0);
+    for (int i = 1; i <= 20; i++)
+    {
+        sim.knob = i / 20.0;
+        run(0.1);
+    }
+    run(2.0);
+    sim.load = 2.0;
+    run(2.0);
+    sim.load = 1.0;
+    sim.knob = 0.3;
+    run(2.0);
+
+    // Meter follows model speed. Model is simplified (no inductance,
+    // instant triac switch), so only rough match is expected.
+    TEST_ASSERT_TRUE(sim.speed > 0.05);
+    TEST_ASSERT_TRUE(fabs(fix16_to_float(meter.speed_smoothed) - sim.speed) < sim.speed * 0.15);
+
+    sim.knob = 0;
+    run(2.0);
+
+    fflush(stdout);
+    fix16_instrument_report(stdout);
+
+    TEST_ASSERT_EQUAL(0, fix16_instrument_overflows());
+}
+
+void test_r_adapt_after_continuous_stop_only() {
+    setup_app();
+
+    // Hot motor, spinning by inertia with pauses
+    sim.r_motor = SIM_R_MOTOR * 1.1;
+    sim.speed = 0.05;
+    sim.speed_fixed = true;
+
+    run(1.0, F16(0.3));
+
+    // Total stop time is > 2s, but each pause is short
+    for (int i = 0; i < 8; i++)
+    {
+        run(0.5, 0);
+        run(0.1, F16(0.3));
+    }
+
+    TEST_ASSERT_EQUAL(fix16_one, meter.r_thermal_factor);
+
+    // Long stop => rotor stopped, R measured at start
+    sim.speed = 0;
+    run(2.5, 0);
+    run(0.1, F16(0.3));
+
+    TEST_ASSERT_TRUE(meter.r_thermal_factor > F16(1.02));
+}
+
+void test_r_adapt_skipped_while_calibrating() {
+    setup_app();
+
+    sim.r_motor = SIM_R_MOTOR * 1.1;
+
+    // Calibrator drives motor
+    meter.r_adapt_enabled = false;
+    run(2.5, 0);
+    run(0.1, F16(0.3));
+
+    TEST_ASSERT_EQUAL(fix16_one, meter.r_thermal_factor);
+
+    meter.r_adapt_enabled = true;
+    run(2.5, 0);
+    run(0.1, F16(0.3));
+
+    TEST_ASSERT_TRUE(meter.r_thermal_factor > F16(1.02));
+}
+
+static bool knob_dial_run(CalibratorWaitKnobDial &d, fix16_t knob, double seconds)
+{
+    io_data_t io_data = {};
+    bool detected = false;
+
+    io_data.knob = knob;
+
+    for (int t = 0; t < (int)(seconds * APP_TICK_FREQUENCY); t++)
+    {
+        if (d.tick(io_data)) detected = true;
+    }
+    return detected;
+}
+
+void test_knob_dial_detect() {
+    CalibratorWaitKnobDial d;
+
+    TEST_ASSERT_FALSE(knob_dial_run(d, 0, 0.5));
+
+#ifdef YIELD_USE_COROUTINES
+    // Frame overflow traps, print real size to tune buffer
+    char msg[100];
+    snprintf(msg, sizeof(msg), "Knob dial coroutine frame: %u bytes",
+        (unsigned)yield_coro_t::last_frame_size);
+    TEST_MESSAGE(msg);
+#endif
+
+    for (int i = 0; i < 2; i++)
+    {
+        TEST_ASSERT_FALSE(knob_dial_run(d, F16(0.5), 0.5));
+        TEST_ASSERT_FALSE(knob_dial_run(d, 0, 0.5));
+    }
+    // Detected when knob returns to zero after 3rd dial
+    TEST_ASSERT_FALSE(knob_dial_run(d, F16(0.5), 0.5));
+    TEST_ASSERT_TRUE(knob_dial_run(d, 0, 0.1));
+}
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_no_overflows_in_real_work);
+    RUN_TEST(test_r_adapt_after_continuous_stop_only);
+    RUN_TEST(test_r_adapt_skipped_while_calibrating);
+    RUN_TEST(test_knob_dial_detect);
+    return UNITY_END();
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include "../src/scheduler.h"
+
+#include <string.h>
+
+// Simulated main loop: control data becomes ready after fixed number of
+// scheduler checks.
+static int checks_left = 0;
+static bool ready() { return checks_left-- <= 0; }
+
+static char trace[64];
+static int trace_len = 0;
+
+static int a_work = 0;
+static int b_work = 0;
+
+static bool task_a() { trace[trace_len++] = 'a'; if (!a_work) return false; a_work--; return true; }
+static bool task_b() { trace[trace_len++] = 'b'; if (!b_work) return false; b_work--; return true; }
+
+
+static void reset_trace() { memset(trace, 0, sizeof(trace)); trace_len = 0; }
+
+
+void test_scheduler_priority_and_budget() {
+    Scheduler<4> s;
+    reset_trace();
+
+    // Added in reverse order, priority should win
+    s.add(task_b, 20, 2);
+    s.add(task_a, 10, 3);
+
+    a_work = 100;
+    b_work = 100;
+    checks_left = 10;
+    s.wait(ready);
+
+    // a - 3 calls (budget), then b - 2 calls, then idle
+    TEST_ASSERT_EQUAL(0, strcmp("aaabb", trace));
+    TEST_ASSERT_EQUAL(5, s.idle_count);
+}
+
+
+void test_scheduler_no_work() {
+    Scheduler<4> s;
+    reset_trace();
+
+    s.add(task_a, 10, 3);
+    s.add(task_b, 20, 3);
+
+    // `a` has work for 1 call only, then reports empty and is skipped
+    a_work = 1;
+    b_work = 0;
+    checks_left = 10;
+    s.wait(ready);
+
+    TEST_ASSERT_EQUAL(0, strcmp("aab", trace));
+    TEST_ASSERT_EQUAL(7, s.idle_count);
+}
+
+
+void test_scheduler_budget_restored_per_tick() {
+    Scheduler<4> s;
+    reset_trace();
+
+    s.add(task_a, 10, 1);
+
+    a_work = 100;
+    checks_left = 3;
+    s.wait(ready);
+    checks_left = 3;
+    s.wait(ready);
+
+    TEST_ASSERT_EQUAL(0, strcmp("aa", trace));
+}
+
+
+void test_scheduler_control_first() {
+    Scheduler<4> s;
+    reset_trace();
+
+    s.add(task_a, 10, 5);
+
+    // Data already ready => no background work at all
+    a_work = 100;
+    checks_left = 0;
+    s.wait(ready);
+
+    TEST_ASSERT_EQUAL(0, trace_len);
+}
+
+
+void test_scheduler_overflow() {
+    Scheduler<2> s;
+
+    TEST_ASSERT_TRUE(s.add(task_a, 10, 1));
+    TEST_ASSERT_TRUE(s.add(task_b, 10, 1));
+    TEST_ASSERT_FALSE(s.add(task_b, 10, 1));
+}
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_scheduler_priority_and_budget);
+    RUN_TEST(test_scheduler_no_work);
+    RUN_TEST(test_scheduler_budget_restored_per_tick);
+    RUN_TEST(test_scheduler_control_first);
+    RUN_TEST(test_scheduler_overflow);
+    return UNITY_END();
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include "../src/math/fix16_math.h"
+#include "../src/math/stability_filter.h"
+
+
+// Brute force reference for window of last N values
+static bool is_stable_ref(const fix16_t *window, int len, fix16_t precision)
+{
+    fix16_t min = fix16_maximum, max = fix16_minimum;
+
+    for (int i = 0; i < len; i++)
+    {
+        if (window[i] < min) min = window[i];
+        if (window[i] > max) max = window[i];
+    }
+
+    fix16_t abs_max = max > 0 ? max : -max;
+
+    return fix16_mul(abs_max, precision / 100) >= max - min;
+}
+
+template <int LENGTH>
+static int stability_mismatches()
+{
+    StabilityFilterTemplate<F16(5), 1, -1, LENGTH> filter;
+    static fix16_t src[5000];
+    uint32_t seed = 3;
+    int errors = 0;
+
+    for (int i = 0; i < 5000; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+
+        // Slow drift + noise, to have both stable & unstable windows
+        src[i] = F16(10) + (i % 700) * 300 + (fix16_t)((seed >> 8) % F16(0.6)) - F16(0.3);
+        filter.push(src[i]);
+
+        if (i + 1 < LENGTH)
+        {
+            if (filter.is_stable()) errors++;
+            continue;
+        }
+
+        const fix16_t *window = src + i + 1 - LENGTH;
+
+        if (filter.is_stable() != is_stable_ref(window, LENGTH, F16(5))) errors++;
+
+        fix16_t sum = 0;
+        for (int j = 0; j < LENGTH; j++) sum += window[j];
+
+        if (filter.average() != fix16_mul(sum, F16(1.0 / LENGTH))) errors++;
+    }
+
+    return errors;
+}
+
+void test_stability_vs_brute_force() {
+    TEST_ASSERT_EQUAL(0, stability_mismatches<1>());
+    TEST_ASSERT_EQUAL(0, stability_mismatches<3>());
+    TEST_ASSERT_EQUAL(0, stability_mismatches<16>());
+    TEST_ASSERT_EQUAL(0, stability_mismatches<200>());
+}
+
+void test_stability_median_and_limit() {
+    StabilityFilterTemplate<F16(1), 3, 20, 3> filter;
+
+    // Median drops single spike of each 3-sample block
+    for (int i = 0; i < 9; i++) filter.push(i % 3 == 1 ? F16(100) : F16(10));
+
+    TEST_ASSERT_TRUE(filter.is_stable());
+    TEST_ASSERT_INT32_WITHIN(F16(0.001), F16(10), filter.average());
+    TEST_ASSERT_FALSE(filter.is_exceeded());
+
+    filter.reset();
+    TEST_ASSERT_FALSE(filter.is_stable());
+
+    for (int i = 0; i < 21; i++) filter.push(i * F16(1));
+
+    TEST_ASSERT_FALSE(filter.is_stable());
+    TEST_ASSERT_TRUE(filter.is_exceeded());
+    TEST_ASSERT_TRUE(filter.is_stable_or_exceeded());
+}
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_stability_vs_brute_force);
+    RUN_TEST(test_stability_median_and_limit);
+    return UNITY_END();
+}
+
+#endif
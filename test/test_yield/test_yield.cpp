@@ -0,0 +1,204 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include "../src/yield.h"
+
+#ifdef __cpp_impl_coroutine
+#include "../src/yield_coro.h"
+#endif
+
+#include <stdio.h>
+#include <chrono>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+// Emits 0, 1, 2, then -1 (finish) and restarts.
+class Counter
+{
+public:
+    int tick() {
+        YIELDABLE_WITH(frame);
+
+        for (i = 0; i < 3; i++) YIELD(i);
+
+        return -1;
+    }
+
+    void reset() { frame.reset(); }
+
+private:
+    yield_frame_t frame;
+    int i = 0;
+};
+
+
+void test_yield_sequence() {
+    Counter c;
+
+    TEST_ASSERT_EQUAL(0, c.tick());
+    TEST_ASSERT_EQUAL(1, c.tick());
+    TEST_ASSERT_EQUAL(2, c.tick());
+    TEST_ASSERT_EQUAL(-1, c.tick());
+    // Restart after finish
+    TEST_ASSERT_EQUAL(0, c.tick());
+}
+
+
+void test_yield_independent_instances() {
+    Counter a, b;
+
+    TEST_ASSERT_EQUAL(0, a.tick());
+    TEST_ASSERT_EQUAL(1, a.tick());
+    TEST_ASSERT_EQUAL(0, b.tick());
+    TEST_ASSERT_EQUAL(2, a.tick());
+    TEST_ASSERT_EQUAL(1, b.tick());
+    TEST_ASSERT_EQUAL(-1, a.tick());
+    TEST_ASSERT_EQUAL(2, b.tick());
+}
+
+
+void test_yield_reset() {
+    Counter c;
+
+    TEST_ASSERT_EQUAL(0, c.tick());
+    TEST_ASSERT_EQUAL(1, c.tick());
+    c.reset();
+    TEST_ASSERT_EQUAL(0, c.tick());
+    TEST_ASSERT_EQUAL(1, c.tick());
+}
+
+
+#ifdef __cpp_impl_coroutine
+
+// The same as `Counter`, on coroutines backend
+class CoroCounter
+{
+public:
+    int tick() {
+        if (!coro.active()) coro = run();
+        coro.resume();
+        return value;
+    }
+
+    void reset() { coro.reset(); }
+
+private:
+    friend struct yield_coro_t::promise_type;
+
+    yield_coro_frame_t<64> coro_frame;
+    yield_coro_t coro;
+    int value = 0;
+
+    yield_coro_t run() {
+        for (int i = 0; i < 3; i++) {
+            value = i;
+            co_yield false;
+        }
+
+        value = -1;
+        co_return true;
+    }
+};
+
+
+void test_coro_sequence() {
+    CoroCounter a, b;
+
+    TEST_ASSERT_EQUAL(0, a.tick());
+    TEST_ASSERT_EQUAL(1, a.tick());
+    TEST_ASSERT_EQUAL(0, b.tick());
+    TEST_ASSERT_EQUAL(2, a.tick());
+    TEST_ASSERT_EQUAL(-1, a.tick());
+    // Restart after finish
+    TEST_ASSERT_EQUAL(0, a.tick());
+    TEST_ASSERT_EQUAL(1, b.tick());
+
+    b.reset();
+    TEST_ASSERT_EQUAL(0, b.tick());
+}
+
+
+void test_coro_frame_too_small() {
+    class Tiny
+    {
+    public:
+        bool tick() {
+            if (!coro.active()) coro = run();
+            return coro.resume();
+        }
+    private:
+        friend struct yield_coro_t::promise_type;
+        yield_coro_frame_t<1> coro_frame;
+        yield_coro_t coro;
+
+        yield_coro_t run() { co_yield true; co_return true; }
+    };
+
+    // Frame overflow should stop program, check in child process
+    fflush(stdout);
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        Tiny t;
+        t.tick();
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    TEST_ASSERT_TRUE(WIFSIGNALED(status));
+}
+
+
+template <typename T>
+static double bench_ns_per_tick(T &fsm, int count)
+{
+    volatile int sink = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < count; i++) sink = sink + fsm.tick();
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+
+void test_backends_benchmark() {
+    const int count = 10000000;
+    Counter macro_fsm;
+    CoroCounter coro_fsm;
+
+    char msg[100];
+
+    snprintf(msg, sizeof(msg), "YIELD macros: %.2f ns/tick", bench_ns_per_tick(macro_fsm, count));
+    TEST_MESSAGE(msg);
+    snprintf(msg, sizeof(msg), "Coroutines:   %.2f ns/tick, frame %u bytes",
+        bench_ns_per_tick(coro_fsm, count), (unsigned)yield_coro_t::last_frame_size);
+    TEST_MESSAGE(msg);
+}
+
+#endif
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_yield_sequence);
+    RUN_TEST(test_yield_independent_instances);
+    RUN_TEST(test_yield_reset);
+#ifdef __cpp_impl_coroutine
+    RUN_TEST(test_coro_sequence);
+    RUN_TEST(test_coro_frame_too_small);
+    RUN_TEST(test_backends_benchmark);
+#endif
+    return UNITY_END();
+}
+
+#endif